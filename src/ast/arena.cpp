@@ -0,0 +1,62 @@
+#include "arena.h"
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+static thread_local AstArena *activeArena = nullptr;
+
+AstArena::AstArena(size_t chunkSize) : chunkSize(chunkSize) {}
+
+AstArena::~AstArena() {
+  reset();
+  for (auto chunk : chunks)
+    std::free(chunk);
+}
+
+void AstArena::newChunk(size_t minSize) {
+  size_t size = minSize > chunkSize ? minSize : chunkSize;
+  char *chunk = (char *)std::malloc(size);
+  if (!chunk) {
+    std::cerr << "Out of memory allocating the ast\n";
+    exit(1);
+  }
+
+  chunks.push_back(chunk);
+  cursor = chunk;
+  limit = chunk + size;
+}
+
+void *AstArena::allocate(size_t size, size_t align) {
+  auto aligned = ((uintptr_t)cursor + align - 1) & ~(uintptr_t)(align - 1);
+  if (!cursor || aligned + size > (uintptr_t)limit) {
+    newChunk(size + align);
+    aligned = ((uintptr_t)cursor + align - 1) & ~(uintptr_t)(align - 1);
+  }
+
+  cursor = (char *)(aligned + size);
+  return (void *)aligned;
+}
+
+void AstArena::reset() {
+  for (auto record = destructors; record; record = record->next)
+    record->destroy(record + 1);
+  destructors = nullptr;
+  typeContext = nullptr;
+
+  if (chunks.empty())
+    return;
+
+  for (size_t i = 1; i < chunks.size(); i++)
+    std::free(chunks[i]);
+  chunks.resize(1);
+  cursor = chunks[0];
+  limit = chunks[0] + chunkSize;
+}
+
+AstArena &AstArena::current() {
+  // Never destroyed, like the ast of a single compilation was never freed
+  static thread_local AstArena *defaultArena = new AstArena();
+  return activeArena ? *activeArena : *defaultArena;
+}
+
+void AstArena::setCurrent(AstArena *arena) { activeArena = arena; }
@@ -0,0 +1,61 @@
+#ifndef _arena
+#define _arena
+
+#include <cstddef>
+#include <vector>
+
+class TypeContext;
+
+/*
+  Bump allocator owning every node and datatype of a compilation. Memory is
+  carved from large chunks and only released all at once by reset(), objects
+  with a non trivial destructor register themselves to be destroyed there.
+*/
+class AstArena {
+public:
+  AstArena(size_t chunkSize = 256 * 1024);
+  ~AstArena();
+
+  AstArena(const AstArena &) = delete;
+  AstArena &operator=(const AstArena &) = delete;
+
+  void *allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+  // Memory for a T that is destroyed on reset, the record sits right before it
+  template <typename T> void *allocateOwned(size_t size) {
+    static_assert(alignof(T) <= alignof(Destructor), "Overaligned type");
+    auto record = (Destructor *)allocate(sizeof(Destructor) + size,
+                                         alignof(Destructor));
+    *record = {[](void *ptr) { ((T *)ptr)->~T(); }, destructors};
+    destructors = record;
+    return record + 1;
+  }
+
+  // Destroys everything allocated so far, the first chunk is kept for reuse
+  void reset();
+
+  // The arena new nodes are allocated from, each thread has its own default
+  static AstArena &current();
+  static void setCurrent(AstArena *arena);
+
+private:
+  friend class TypeContext;
+
+  // Kept inside the arena itself, newest first
+  struct Destructor {
+    void (*destroy)(void *);
+    Destructor *next;
+  };
+
+  size_t chunkSize;
+  std::vector<char *> chunks;
+  char *cursor = nullptr;
+  char *limit = nullptr;
+  Destructor *destructors = nullptr;
+  // Datatypes of the nodes in this arena, interned on first use
+  TypeContext *typeContext = nullptr;
+
+  void newChunk(size_t minSize);
+};
+
+#endif
@@ -2,10 +2,70 @@
 #include <cerrno>
 #include <map>
 #include <string>
+#include <type_traits>
 #include <vector>
 
-std::set<std::string> logicalOperators = {
-    "!=", "==", "<=", ">=", "<", ">", "||", "&&"};
+const char *operatorName(ExprOperator op) {
+  switch (op) {
+  case ExprOperator::ASSIGN:
+    return "=";
+  case ExprOperator::PLUS:
+    return "+";
+  case ExprOperator::MINUS:
+    return "-";
+  case ExprOperator::MULT:
+    return "*";
+  case ExprOperator::DIV:
+    return "/";
+  case ExprOperator::MOD:
+    return "%";
+  case ExprOperator::EQ:
+    return "==";
+  case ExprOperator::NEQ:
+    return "!=";
+  case ExprOperator::GT:
+    return ">";
+  case ExprOperator::GTE:
+    return ">=";
+  case ExprOperator::LT:
+    return "<";
+  case ExprOperator::LTE:
+    return "<=";
+  case ExprOperator::NOT:
+    return "!";
+  case ExprOperator::OR:
+    return "||";
+  case ExprOperator::AND:
+    return "&&";
+  case ExprOperator::B_OR:
+    return "|";
+  case ExprOperator::B_AND:
+    return "&";
+  case ExprOperator::B_XOR:
+    return "^";
+  case ExprOperator::B_LSHIFT:
+    return "<<";
+  case ExprOperator::B_RSHIFT:
+    return ">>";
+  }
+  return "";
+}
+
+bool isLogicalOperator(ExprOperator op) {
+  switch (op) {
+  case ExprOperator::EQ:
+  case ExprOperator::NEQ:
+  case ExprOperator::GT:
+  case ExprOperator::GTE:
+  case ExprOperator::LT:
+  case ExprOperator::LTE:
+  case ExprOperator::OR:
+  case ExprOperator::AND:
+    return true;
+  default:
+    return false;
+  }
+}
 
 void AstNode::visitChildren(BaseVisitor *visitor) {
   for (auto child : this->_children)
@@ -97,18 +157,6 @@ bool DataType::isInt(RawDataType &raw) {
          raw == RawDataType::INT || raw == RawDataType::LONG;
 }
 
-bool DataType::equals(DataType *other) {
-  if ((!inner && other->inner) || (inner && !other->inner))
-    return false;
-  if (raw != other->raw)
-    return false;
-  if (raw == RawDataType::STRUCT && ident != other->ident)
-    return false;
-  if (inner && !inner->equals(other->inner))
-    return false;
-  return true;
-}
-
 bool DataType::isAddress(RawDataType &raw) {
   return raw == RawDataType::POINTER || raw == RawDataType::ARRAY;
 }
@@ -117,8 +165,7 @@ bool DataType::isFloat(RawDataType &raw) {
   return raw == RawDataType::FLOAT || raw == RawDataType::DOUBLE;
 }
 
-static std::vector<DataType *> typesRefs;
-static std::map<RawDataType, int> sizesMap{
+static const std::map<RawDataType, int> sizesMap{
     {RawDataType::CHAR, 1},    {RawDataType::SHORT, 2},
     {RawDataType::INT, 4},     {RawDataType::FLOAT, 4},
     {RawDataType::LONG, 8},    {RawDataType::DOUBLE, 8},
@@ -126,110 +173,123 @@ static std::map<RawDataType, int> sizesMap{
     {RawDataType::STRUCT, 8},
 };
 
-DataType::DataType() {}
+// Datatypes are not registered in the arena, nothing to destroy
+static_assert(std::is_trivially_destructible<DataType>::value,
+              "DataType must stay trivially destructible");
+
+TypeContext &TypeContext::current() {
+  auto &arena = AstArena::current();
+  if (!arena.typeContext)
+    arena.typeContext =
+        new (arena.allocateOwned<TypeContext>(sizeof(TypeContext)))
+            TypeContext(arena);
+  return *arena.typeContext;
+}
 
-DataType *DataType::build(RawDataType raw) {
-  auto datatype = new DataType();
+DataType *TypeContext::make(RawDataType raw, DataType *inner,
+                            ulint arrLength) {
+  auto datatype = new (arena.allocate(sizeof(DataType), alignof(DataType)))
+      DataType();
   datatype->raw = raw;
-  datatype->inner = nullptr;
-  datatype->arrLength = 0;
-  datatype->size = sizesMap[raw];
-  typesRefs.push_back(datatype);
+  datatype->inner = inner;
+  datatype->arrLength = arrLength;
+  // Looked up without inserting, the map is read by every thread
+  auto size = sizesMap.find(raw);
+  datatype->size = size != sizesMap.end() ? size->second : 0;
+  datatype->pointerTo = nullptr;
   return datatype;
 }
 
-DataType *DataType::buildPointer(DataType *type) {
-  if (type->raw == RawDataType::ERROR)
-    return DataType::build(RawDataType::ERROR);
-
-  auto datatype = build(RawDataType::POINTER);
-  datatype->inner = type;
+DataType *TypeContext::get(RawDataType raw) {
+  auto &datatype = basic[(int)raw];
+  if (!datatype)
+    datatype = make(raw, nullptr, 0);
   return datatype;
 }
 
-DataType *DataType::build(TypeDefNode *node) {
-  if (node->_pointsTo) {
-    auto datatype = build(RawDataType::POINTER);
-    datatype->inner = build(node->_pointsTo);
-    return datatype;
-  }
-
-  if (node->_arrayOf) {
-    auto datatype = build(RawDataType::ARRAY);
-    datatype->inner = build(node->_arrayOf);
-    datatype->arrLength = node->_arrSize;
-    return datatype;
+DataType *TypeContext::getStruct(Symbol ident) {
+  auto &datatype = structs[ident];
+  if (!datatype) {
+    datatype = make(RawDataType::STRUCT, nullptr, 0);
+    datatype->ident = ident;
   }
+  return datatype;
+}
 
-  DataType *datatype;
-
-  if (node->_rawIdent == "char") {
-    datatype = build(RawDataType::CHAR);
-  } else if (node->_rawIdent == "short") {
-    datatype = build(RawDataType::SHORT);
-  } else if (node->_rawIdent == "int") {
-    datatype = build(RawDataType::INT);
-  } else if (node->_rawIdent == "long") {
-    datatype = build(RawDataType::LONG);
-  } else if (node->_rawIdent == "float") {
-    datatype = build(RawDataType::FLOAT);
-  } else if (node->_rawIdent == "double") {
-    datatype = build(RawDataType::DOUBLE);
-  } else if (node->_rawIdent == "void") {
-    datatype = build(RawDataType::VOID);
-  } else {
-    datatype = build(RawDataType::STRUCT);
-  }
+DataType *TypeContext::getPointer(DataType *inner) {
+  if (!inner->pointerTo)
+    inner->pointerTo = make(RawDataType::POINTER, inner, 0);
+  return inner->pointerTo;
+}
 
-  datatype->ident = node->_rawIdent;
+DataType *TypeContext::getArray(DataType *inner, ulint length) {
+  auto &datatype = arrays[{inner, length}];
+  if (!datatype)
+    datatype = make(RawDataType::ARRAY, inner, length);
   return datatype;
 }
 
-DataType *DataType::fromNumber(std::string &num) {
-  bool isFloat = false;
-
-  for (char c : num)
-    if (c == '.')
-      isFloat = true;
-
-  DataType *dataType;
-
-  if (isFloat) {
-    double val = std::stod(num);
-    if (((float)val) == val)
-      dataType = build(RawDataType::FLOAT);
-    else
-      dataType = build(RawDataType::DOUBLE);
-  } else {
-    long val = std::stol(num);
-    if (val < 0x7f)
-      dataType = build(RawDataType::CHAR);
-    else if (val < 0x7fff)
-      dataType = build(RawDataType::SHORT);
-    else if (val < 0x7fffffff)
-      dataType = build(RawDataType::INT);
-    else
-      dataType = build(RawDataType::LONG);
-  }
+DataType *DataType::build(RawDataType raw) {
+  return TypeContext::current().get(raw);
+}
 
-  dataType->ident = num;
+DataType *DataType::buildPointer(DataType *type) {
+  if (type->raw == RawDataType::ERROR)
+    return DataType::build(RawDataType::ERROR);
+
+  return TypeContext::current().getPointer(type);
+}
+
+DataType *DataType::buildArray(DataType *inner, ulint length) {
+  return TypeContext::current().getArray(inner, length);
+}
+
+DataType *DataType::build(TypeDefNode *node) {
+  if (node->_pointsTo)
+    return TypeContext::current().getPointer(build(node->_pointsTo));
+
+  if (node->_arrayOf)
+    return buildArray(build(node->_arrayOf), node->_arrSize);
+
+  static const SymbolMap<RawDataType> baseTypes = []() {
+    SymbolMap<RawDataType> baseTypes;
+    baseTypes["char"] = RawDataType::CHAR;
+    baseTypes["short"] = RawDataType::SHORT;
+    baseTypes["int"] = RawDataType::INT;
+    baseTypes["long"] = RawDataType::LONG;
+    baseTypes["float"] = RawDataType::FLOAT;
+    baseTypes["double"] = RawDataType::DOUBLE;
+    baseTypes["void"] = RawDataType::VOID;
+    return baseTypes;
+  }();
+
+  if (baseTypes.contains(node->_rawIdent))
+    return build(baseTypes.lookup(node->_rawIdent));
+  return TypeContext::current().getStruct(node->_rawIdent);
+}
+
+DataType *DataType::fromInteger(uint64_t value) {
+  if (value < 0x7f)
+    return build(RawDataType::CHAR);
+  if (value < 0x7fff)
+    return build(RawDataType::SHORT);
+  if (value < 0x7fffffff)
+    return build(RawDataType::INT);
+  return build(RawDataType::LONG);
+}
 
-  return dataType;
+DataType *DataType::fromFloat(double value) {
+  if (((float)value) == value)
+    return build(RawDataType::FLOAT);
+  return build(RawDataType::DOUBLE);
 }
 
 DataType *DataType::fromString(std::string &str) {
-  auto dataType = build(RawDataType::ARRAY);
-  dataType->inner = build(RawDataType::CHAR);
-  dataType->arrLength = str.size();
-  dataType->ident = str;
-  dataType->size = str.size();
-  return dataType;
+  return buildArray(build(RawDataType::CHAR), str.size());
 }
 
 DataType *DataType::fromChar(std::string &ch) {
-  auto dataType = build(RawDataType::CHAR);
-  dataType->ident = ch;
-  return dataType;
+  return build(RawDataType::CHAR);
 }
 
 DataType *promote(DataType *left, DataType *right) {
@@ -270,7 +330,7 @@ bool preValidate(DataType *left, DataType *right) {
   return true;
 }
 
-DataType *DataType::getOperationType(DataType *left, std::string op,
+DataType *DataType::getOperationType(DataType *left, ExprOperator op,
                                      DataType *right) {
   if (!preValidate(left, right))
     return build(RawDataType::ERROR);
@@ -283,12 +343,12 @@ DataType *DataType::getOperationType(DataType *left, std::string op,
   return DataType::build(RawDataType::ERROR);
 }
 
-DataType *DataType::getResultType(DataType *left, std::string op,
+DataType *DataType::getResultType(DataType *left, ExprOperator op,
                                   DataType *right) {
   if (!preValidate(left, right))
     return build(RawDataType::ERROR);
 
-  if (logicalOperators.find(op) != logicalOperators.end()) {
+  if (isLogicalOperator(op)) {
     if (!isComparable(left, right))
       return DataType::build(RawDataType::ERROR);
     return DataType::build(RawDataType::INT);
@@ -297,7 +357,7 @@ DataType *DataType::getResultType(DataType *left, std::string op,
   if (isNumeric(left->raw) && isNumeric(right->raw))
     return promote(left, right);
 
-  if (op == "=") {
+  if (op == ExprOperator::ASSIGN) {
     if (left->equals(right))
       return left;
 
@@ -1,6 +1,9 @@
 #ifndef _ast
 #define _ast
 
+#include "arena.h"
+#include "location.h"
+#include "symbols.h"
 #include <iostream>
 #include <map>
 #include <set>
@@ -103,24 +106,57 @@ public:
   virtual void visitExprConstant(ExprConstantNode *node) {};
 };
 
-extern std::set<std::string> logicalOperators;
+/*
+  Unary nodes reuse PLUS, MINUS, MULT, B_AND and NOT for absolute value,
+  negation, dereference, reference and logical not
+*/
+enum class ExprOperator : uint8_t {
+  ASSIGN,
+
+  PLUS,
+  MINUS,
+  MULT,
+  DIV,
+  MOD,
+
+  EQ,
+  NEQ,
+  GT,
+  GTE,
+  LT,
+  LTE,
+
+  NOT,
+  OR,
+  AND,
+
+  B_OR,
+  B_AND,
+  B_XOR,
+  B_LSHIFT,
+  B_RSHIFT,
+};
+
+const char *operatorName(ExprOperator op);
+bool isLogicalOperator(ExprOperator op);
 
+/*
+  Datatypes are interned by the TypeContext, structurally equal types are the
+  same instance so they are compared by pointer and never modified once built.
+*/
 class DataType {
 public:
-  DataType(TypeDefNode *node);
-  ~DataType();
-
   RawDataType raw;
   DataType *inner;
-  std::string ident;
+  Symbol ident;
 
   ulint size;
   ulint arrLength;
 
-  static DataType *getResultType(DataType *left, std::string op,
-                                 DataType *right);
-  static DataType *getOperationType(DataType *left, std::string op,
+  static DataType *getResultType(DataType *left, ExprOperator op,
                                  DataType *right);
+  static DataType *getOperationType(DataType *left, ExprOperator op,
+                                    DataType *right);
 
   static bool isComparable(DataType *left, DataType *right);
 
@@ -132,31 +168,63 @@ public:
   static DataType *build(RawDataType type);
   static DataType *build(TypeDefNode *node);
   static DataType *buildPointer(DataType *type);
+  static DataType *buildArray(DataType *inner, ulint length);
 
-  static DataType *fromNumber(std::string &num);
+  static DataType *fromInteger(uint64_t value);
+  static DataType *fromFloat(double value);
   static DataType *fromString(std::string &str);
   static DataType *fromChar(std::string &ch);
 
-  bool equals(DataType *other);
+  bool equals(DataType *other) { return this == other; }
+
+private:
+  friend class TypeContext;
+  DataType *pointerTo;
+
+  DataType() = default;
+};
+
+class TypeContext {
+public:
+  static TypeContext &current();
+
+  DataType *get(RawDataType raw);
+  DataType *getStruct(Symbol ident);
+  DataType *getPointer(DataType *inner);
+  DataType *getArray(DataType *inner, ulint length);
 
 private:
-  DataType();
+  // The arena owning the context, types are released with the nodes
+  AstArena &arena;
+
+  DataType *basic[(int)RawDataType::DOUBLE + 1] = {};
+  SymbolMap<DataType *> structs;
+  std::map<std::pair<DataType *, ulint>, DataType *> arrays;
+
+  TypeContext(AstArena &arena) : arena(arena) {}
+  DataType *make(RawDataType raw, DataType *inner, ulint arrLength);
 };
 
-/* Attributes starting with _ are filled in parsing time */
+/*
+  Attributes starting with _ are filled in parsing time. Nodes live in the
+  current AstArena and are released with it, never one by one.
+*/
 class AstNode {
 public:
-  AstNode(NodeType nodeType, std::string &filename, int line, int startCol,
-          AstNode *parent = nullptr) {
+  AstNode(NodeType nodeType, SourceLoc loc, AstNode *parent = nullptr) {
     this->nodeType = nodeType;
-    this->_line = line;
-    this->_startCol = startCol;
-    this->_filename = filename;
+    this->_loc = loc;
 
     this->_parent = parent;
     if (parent)
       parent->_children.push_back(this);
   };
+  virtual ~AstNode() {}
+
+  static void *operator new(size_t size) {
+    return AstArena::current().allocateOwned<AstNode>(size);
+  }
+  static void operator delete(void *) {}
 
   void visit(BaseVisitor *visitor);
   void visitChildren(BaseVisitor *visitor);
@@ -168,45 +236,43 @@ public:
   AstNode *_parent;
   std::vector<AstNode *> _children;
 
-  int _line;
-  int _startCol;
-  std::string _filename;
+  SourceLoc _loc;
 
 private:
   NodeType nodeType;
 };
 
-const std::set<std::string> reservedFunctions = {"sizeof"};
-const std::string MAIN_FUNC = "main";
-const std::string INIT_FUNC = "init";
+const Symbol SIZEOF_FUNC = "sizeof";
+const Symbol MAIN_FUNC = "main";
+const Symbol INIT_FUNC = "init";
+const std::set<Symbol> reservedFunctions = {SIZEOF_FUNC};
 
 class ProgramNode : public AstNode {
 public:
-  std::map<std::string, FunctionNode *> funcs;
-  std::map<std::string, VarDefNode *> globalVars;
-  std::map<std::string, StructDefNode *> structDefs;
+  SymbolMap<FunctionNode *> funcs;
+  SymbolMap<VarDefNode *> globalVars;
+  SymbolMap<StructDefNode *> structDefs;
   std::vector<std::pair<std::string, bool>> imports;
 
-  ProgramNode(std::string &filename, int line, int startCol)
-      : AstNode(NodeType::PROGRAM, filename, line, startCol, nullptr) {
+  ProgramNode(SourceLoc loc) : AstNode(NodeType::PROGRAM, loc, nullptr) {
     this->_children = _children;
   }
 
-  // Destructive operation deletes the other node and some attributes may be
-  // loosen
+  // Destructive operation empties the other node and some attributes may be
+  // loosen, the node itself is released with the arena
   void merge(ProgramNode *other) {
     for (auto child : other->_children) {
       child->_parent = this;
       this->_children.push_back(child);
     }
 
-    delete other;
+    other->_children.clear();
   }
 };
 
 class FunctionNode : public AstNode {
 public:
-  std::string _name;
+  Symbol _name;
   std::string _externName = "";
   std::vector<VarDefNode *> _params;
   std::vector<VarDefNode *> _innerVars;
@@ -214,13 +280,19 @@ public:
   TypeDefNode *_retTypeDef;
   bool _export = false;
   bool _external = false;
-
-  std::map<std::string, VarDefNode *> localVars;
+  // Only runs at compile time, calls are replaced by their result
+  bool _constant = false;
+  // Type parameters, calls instantiate a copy per deduced argument types
+  std::vector<Symbol> _genericArgNames;
+  FunctionNode *_genericOf = nullptr;
+  // Instances keep their own body even when generics share shapes
+  bool _hot = false;
+
+  SymbolMap<VarDefNode *> localVars;
   DataType *retType = nullptr;
 
-  FunctionNode(std::string &filename, int line, int startCol, AstNode *parent,
-               std::string ident)
-      : AstNode(NodeType::FUNCTION, filename, line, startCol, parent) {
+  FunctionNode(SourceLoc loc, AstNode *parent, Symbol ident)
+      : AstNode(NodeType::FUNCTION, loc, parent) {
     _name = ident;
     _body = nullptr;
     _retTypeDef = nullptr;
@@ -230,19 +302,23 @@ public:
 class StructDefNode : public AstNode {
 public:
   std::vector<AstNode *> _members;
-  std::vector<std::string> _genericArgNames;
-  std::string _name;
+  std::vector<Symbol> _genericArgNames;
+  // Type of each integer parameter, Buf<N: int>, null for type parameters
+  std::vector<TypeDefNode *> _genericArgTypes;
+  // Value of an integer parameter left out at a use site, Buf<N: int = 512>
+  std::vector<TypeDefNode *> _genericArgDefaults;
+  StructDefNode *_genericOf = nullptr;
+  Symbol _name;
   bool _export = false;
   bool _external = false;
 
-  std::map<std::string, VarDefNode *> membersDef;
-  std::map<std::string, FunctionNode *> funcMembers;
-  std::map<std::string, int> membersOffset;
+  SymbolMap<VarDefNode *> membersDef;
+  SymbolMap<FunctionNode *> funcMembers;
+  SymbolMap<int> membersOffset;
   int size;
 
-  StructDefNode(std::string &filename, int line, int startCol, AstNode *parent,
-                std::string name)
-      : AstNode(NodeType::STRUCT_DEF, filename, line, startCol, parent) {
+  StructDefNode(SourceLoc loc, AstNode *parent, Symbol name)
+      : AstNode(NodeType::STRUCT_DEF, loc, parent) {
     this->_name = name;
   }
 };
@@ -250,8 +326,8 @@ public:
 class BodyNode : public AstNode {
 public:
   std::vector<AstNode *> _statements;
-  BodyNode(std::string &filename, int line, int startCol, AstNode *parent)
-      : AstNode(NodeType::BODY, filename, line, startCol, parent) {}
+  BodyNode(SourceLoc loc, AstNode *parent)
+      : AstNode(NodeType::BODY, loc, parent) {}
 };
 
 class IfNode : public AstNode {
@@ -260,8 +336,7 @@ public:
   BodyNode *_ifBody;
   BodyNode *_elseBody;
 
-  IfNode(std::string &filename, int line, int startCol, AstNode *parent)
-      : AstNode(NodeType::IF, filename, line, startCol, parent) {
+  IfNode(SourceLoc loc, AstNode *parent) : AstNode(NodeType::IF, loc, parent) {
     _expr = nullptr;
     _ifBody = nullptr;
     _elseBody = nullptr;
@@ -273,8 +348,8 @@ public:
   ExprNode *_expr;
   BodyNode *_body;
 
-  WhileNode(std::string &filename, int line, int startCol, AstNode *parent)
-      : AstNode(NodeType::WHILE, filename, line, startCol, parent) {
+  WhileNode(SourceLoc loc, AstNode *parent)
+      : AstNode(NodeType::WHILE, loc, parent) {
     _expr = nullptr;
     _body = nullptr;
   }
@@ -287,8 +362,8 @@ public:
   ExprNode *_inc;
   BodyNode *_body;
 
-  ForNode(std::string &filename, int line, int startCol, AstNode *parent)
-      : AstNode(NodeType::FOR, filename, line, startCol, parent) {
+  ForNode(SourceLoc loc, AstNode *parent)
+      : AstNode(NodeType::FOR, loc, parent) {
     _start = nullptr;
     _cond = nullptr;
     _body = nullptr;
@@ -298,7 +373,7 @@ public:
 
 class VarDefNode : public AstNode {
 public:
-  std::string _name;
+  Symbol _name;
   TypeDefNode *_typeDef;
   ExprNode *_defaultVal;
   std::vector<ExprNode *> _initArgs;
@@ -308,9 +383,9 @@ public:
 
   DataType *type = nullptr;
 
-  VarDefNode(std::string &filename, int line, int startCol, AstNode *parent,
-             std::string name, bool constant = false)
-      : AstNode(NodeType::VAR_DEF, filename, line, startCol, parent) {
+  VarDefNode(SourceLoc loc, AstNode *parent, Symbol name,
+             bool constant = false)
+      : AstNode(NodeType::VAR_DEF, loc, parent) {
     this->_name = name;
     _constant = constant;
     _typeDef = nullptr;
@@ -322,8 +397,8 @@ class BreakNode : public AstNode {
 public:
   AstNode *target;
 
-  BreakNode(std::string &filename, int line, int startCol, AstNode *parent)
-      : AstNode(NodeType::BREAK, filename, line, startCol, parent) {
+  BreakNode(SourceLoc loc, AstNode *parent)
+      : AstNode(NodeType::BREAK, loc, parent) {
     target = nullptr;
   }
 };
@@ -333,8 +408,8 @@ public:
   ExprNode *_expr;
   DataType *retType;
 
-  ReturnNode(std::string &filename, int line, int startCol, AstNode *parent)
-      : AstNode(NodeType::RETURN, filename, line, startCol, parent) {
+  ReturnNode(SourceLoc loc, AstNode *parent)
+      : AstNode(NodeType::RETURN, loc, parent) {
     _expr = nullptr;
   }
 };
@@ -344,35 +419,38 @@ public:
   std::vector<TypeDefNode *> _genericArgsDefs;
   TypeDefNode *_pointsTo;
   TypeDefNode *_arrayOf;
-  int _arrSize;
-  std::string _rawIdent;
+  ulint _arrSize;
+  Symbol _rawIdent;
   DataType *dataType;
 
-  TypeDefNode(std::string &filename, int line, int startCol)
-      : AstNode(NodeType::TYPE_DEF, filename, line, startCol, nullptr) {
+  // Integer template arguments, Buf<512>, are spelled in _rawIdent. Array
+  // sizes naming an integer parameter, char[N], keep the name until the
+  // template is instantiated
+  bool _valueArg = false;
+  ulint _value = 0;
+  Symbol _arrSizeParam;
+
+  TypeDefNode(SourceLoc loc) : AstNode(NodeType::TYPE_DEF, loc, nullptr) {
     _pointsTo = nullptr;
     _arrayOf = nullptr;
     dataType = nullptr;
   }
 
-  static TypeDefNode *build(std::string type, std::string &filename, int line,
-                            int startCol) {
-    auto typeDef = new TypeDefNode(filename, line, startCol);
+  static TypeDefNode *build(Symbol type, SourceLoc loc) {
+    auto typeDef = new TypeDefNode(loc);
     typeDef->_rawIdent = type;
     return typeDef;
   }
-  static TypeDefNode *buildPointer(TypeDefNode *innerType,
-                                   std::string &filename, int line,
-                                   int startCol) {
-    auto typeDef = new TypeDefNode(filename, line, startCol);
+  static TypeDefNode *buildPointer(TypeDefNode *innerType, SourceLoc loc) {
+    auto typeDef = new TypeDefNode(loc);
     typeDef->_pointsTo = innerType;
     innerType->_parent = typeDef;
     typeDef->_children.push_back(innerType);
     return typeDef;
   }
-  static TypeDefNode *buildArray(TypeDefNode *innerType, std::string &filename,
-                                 int size, int line, int startCol) {
-    auto typeDef = new TypeDefNode(filename, line, startCol);
+  static TypeDefNode *buildArray(TypeDefNode *innerType, ulint size,
+                                 SourceLoc loc) {
+    auto typeDef = new TypeDefNode(loc);
     typeDef->_arrayOf = innerType;
     typeDef->_arrSize = size;
     innerType->_parent = typeDef;
@@ -388,9 +466,8 @@ public:
   VarDefNode *var;
   FunctionNode *func;
 
-  ExprNode(NodeType nodeType, std::string &filename, int line, int startCol,
-           AstNode *parent)
-      : AstNode(nodeType, filename, line, startCol, parent) {
+  ExprNode(NodeType nodeType, SourceLoc loc, AstNode *parent)
+      : AstNode(nodeType, loc, parent) {
     type = nullptr;
     var = nullptr;
     func = nullptr;
@@ -399,11 +476,10 @@ public:
 
 class ExprVarRefNode : public ExprNode {
 public:
-  std::string _ident;
+  Symbol _ident;
 
-  ExprVarRefNode(std::string &filename, int line, int startCol, AstNode *parent,
-                 std::string varName)
-      : ExprNode(NodeType::VAR_REF, filename, line, startCol, parent) {
+  ExprVarRefNode(SourceLoc loc, AstNode *parent, Symbol varName)
+      : ExprNode(NodeType::VAR_REF, loc, parent) {
     this->_ident = varName;
   }
 };
@@ -413,9 +489,9 @@ public:
   ExprNode *_inner;
   ExprNode *_index;
 
-  ExprIndex(std::string &filename, int line, int startCol, AstNode *parent,
-            ExprNode *inner, ExprNode *index)
-      : ExprNode(NodeType::INDEX_ACCESS, filename, line, startCol, parent) {
+  ExprIndex(SourceLoc loc, AstNode *parent, ExprNode *inner,
+            ExprNode *index)
+      : ExprNode(NodeType::INDEX_ACCESS, loc, parent) {
     if (!inner || !index) {
       std::cerr << "Was not possible to open the file\n";
       exit(1);
@@ -434,13 +510,13 @@ public:
 class ExprMemberAccess : public ExprNode {
 public:
   ExprNode *_struct;
-  std::string _memberName;
+  Symbol _memberName;
 
   StructDefNode *structDef;
 
-  ExprMemberAccess(std::string &filename, int line, int startCol,
-                   AstNode *parent, ExprNode *_struct, std::string memberName)
-      : ExprNode(NodeType::MEMBER_ACCESS, filename, line, startCol, parent) {
+  ExprMemberAccess(SourceLoc loc, AstNode *parent, ExprNode *_struct,
+                   Symbol memberName)
+      : ExprNode(NodeType::MEMBER_ACCESS, loc, parent) {
     if (!_struct) {
       std::cerr << "struct cannot be null\n";
       exit(1);
@@ -460,9 +536,8 @@ public:
 
   FunctionNode *func;
 
-  ExprCallNode(std::string &filename, int line, int startCol, AstNode *parent,
-               ExprNode *ref)
-      : ExprNode(NodeType::FUNCCALL, filename, line, startCol, parent) {
+  ExprCallNode(SourceLoc loc, AstNode *parent, ExprNode *ref)
+      : ExprNode(NodeType::FUNCCALL, loc, parent) {
     this->_ref = ref;
     this->_children.push_back(ref);
     ref->_parent = this;
@@ -472,16 +547,14 @@ public:
 class ExprBinaryNode : public ExprNode {
 public:
   ExprNode *_left;
-  std::string _op;
-  int _opNum;
+  ExprOperator _op;
   ExprNode *_right;
 
-  ExprBinaryNode(std::string &filename, int line, int startCol, AstNode *parent,
-                 ExprNode *left, std::string op, int opNum, ExprNode *right)
-      : ExprNode(NodeType::EXPR_BINARY, filename, line, startCol, parent) {
+  ExprBinaryNode(SourceLoc loc, AstNode *parent, ExprNode *left,
+                 ExprOperator op, ExprNode *right)
+      : ExprNode(NodeType::EXPR_BINARY, loc, parent) {
     this->_left = left;
     this->_op = op;
-    this->_opNum = opNum;
     this->_right = right;
 
     left->_parent = this;
@@ -493,15 +566,12 @@ public:
 
 class ExprUnaryNode : public ExprNode {
 public:
-  std::string _op;
-  int _opNum;
+  ExprOperator _op;
   ExprNode *_expr;
 
-  ExprUnaryNode(std::string &filename, int line, int startCol, AstNode *parent,
-                std::string op, int opNum, ExprNode *expr)
-      : ExprNode(NodeType::EXPR_UNARY, filename, line, startCol, parent) {
+  ExprUnaryNode(SourceLoc loc, AstNode *parent, ExprOperator op, ExprNode *expr)
+      : ExprNode(NodeType::EXPR_UNARY, loc, parent) {
     this->_op = op;
-    this->_opNum = opNum;
     this->_expr = expr;
     expr->_parent = this;
     this->_children.push_back(expr);
@@ -513,12 +583,36 @@ public:
   std::string _rawValue;
   int _rawType;
 
-  ExprConstantNode(std::string &filename, int line, int startCol,
-                   AstNode *parent, std::string rawValue, int rawType)
-      : ExprNode(NodeType::EXPR_CONSTANT, filename, line, startCol, parent) {
+  // Numbers and chars are decoded once by the lexer
+  union {
+    uint64_t _intValue = 0;
+    double _floatValue;
+  };
+  bool _isFloat = false;
+
+  // Arrays computed at compile time, flattened in row-major order. Floats are
+  // kept as the bits of a double
+  std::vector<uint64_t> elements;
+
+  ExprConstantNode(SourceLoc loc, AstNode *parent, std::string rawValue,
+                   int rawType)
+      : ExprNode(NodeType::EXPR_CONSTANT, loc, parent) {
     this->_rawValue = rawValue;
     this->_rawType = rawType;
   }
+
+  ExprConstantNode(SourceLoc loc, AstNode *parent, std::string rawValue,
+                   int rawType, uint64_t intValue)
+      : ExprConstantNode(loc, parent, rawValue, rawType) {
+    this->_intValue = intValue;
+  }
+
+  ExprConstantNode(SourceLoc loc, AstNode *parent, std::string rawValue,
+                   int rawType, double floatValue)
+      : ExprConstantNode(loc, parent, rawValue, rawType) {
+    this->_floatValue = floatValue;
+    this->_isFloat = true;
+  }
 };
 
 #endif
\ No newline at end of file
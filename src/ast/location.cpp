@@ -0,0 +1,37 @@
+#include "location.h"
+#include <iostream>
+#include <mutex>
+
+FileTable::FileTable() { add(""); }
+
+FileTable &FileTable::global() {
+  static FileTable table;
+  return table;
+}
+
+FileId FileTable::add(const std::string &path) {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  auto it = ids.find(path);
+  if (it != ids.end())
+    return it->second;
+
+  if (paths.size() > UINT16_MAX) {
+    std::cerr << "Too many source files\n";
+    exit(1);
+  }
+
+  FileId id = paths.size();
+  paths.push_back(path);
+  ids[path] = id;
+  return id;
+}
+
+const std::string &FileTable::name(FileId id) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return paths[id];
+}
+
+std::string SourceLoc::str() const {
+  return getFileName() + ":" + std::to_string(getLine()) + ":" +
+         std::to_string(getCol());
+}
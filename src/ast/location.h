@@ -0,0 +1,54 @@
+#ifndef _location
+#define _location
+
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+typedef uint16_t FileId;
+
+/*
+  Canonical paths of every source file read during the compilation, nodes
+  only keep the id. Id 0 is the empty path used by synthesized nodes.
+*/
+class FileTable {
+public:
+  static FileTable &global();
+
+  FileId add(const std::string &path);
+  const std::string &name(FileId id) const;
+
+private:
+  FileTable();
+
+  mutable std::shared_mutex mutex;
+  std::deque<std::string> paths;
+  std::unordered_map<std::string, FileId> ids;
+};
+
+// File, line and column packed in 64 bits
+class SourceLoc {
+public:
+  SourceLoc() : file(0), line(0), col(0) {}
+  SourceLoc(FileId file, int line, int col)
+      : file(file), line(line), col(col) {}
+
+  FileId getFile() const { return file; }
+  int getLine() const { return line; }
+  int getCol() const { return col; }
+  const std::string &getFileName() const {
+    return FileTable::global().name(file);
+  }
+
+  // file:line:col as printed in the diagnostics
+  std::string str() const;
+
+private:
+  uint64_t file : 16;
+  uint64_t line : 28;
+  uint64_t col : 20;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "symbols.h"
+#include <mutex>
+
+SymbolTable::SymbolTable() { intern(""); }
+
+SymbolTable &SymbolTable::global() {
+  static SymbolTable table;
+  return table;
+}
+
+SymbolId SymbolTable::intern(std::string_view name) {
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = ids.find(name);
+    if (it != ids.end())
+      return it->second;
+  }
+
+  // Interned by another thread meanwhile, find looks again
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  auto it = ids.find(name);
+  if (it != ids.end())
+    return it->second;
+
+  SymbolId id = names.size();
+  names.emplace_back(name);
+  ids[names.back()] = id;
+  return id;
+}
+
+// Deque elements never move, the reference outlives the lock
+const std::string &SymbolTable::name(SymbolId id) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return names[id];
+}
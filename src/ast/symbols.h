@@ -0,0 +1,176 @@
+#ifndef _symbols
+#define _symbols
+
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+typedef uint32_t SymbolId;
+
+/*
+  Every identifier is interned once, the rest of the compiler compares and
+  hashes the 32-bit ids. Names are never released, id 0 is the empty name.
+  The table is shared by the compilations running in parallel.
+*/
+class SymbolTable {
+public:
+  static SymbolTable &global();
+
+  SymbolId intern(std::string_view name);
+  const std::string &name(SymbolId id) const;
+
+private:
+  SymbolTable();
+
+  mutable std::shared_mutex mutex;
+  std::deque<std::string> names;
+  std::unordered_map<std::string_view, SymbolId> ids;
+};
+
+class Symbol {
+public:
+  Symbol() : id(0) {}
+  Symbol(std::string_view name) : id(SymbolTable::global().intern(name)) {}
+  Symbol(const std::string &name) : Symbol(std::string_view(name)) {}
+  Symbol(const char *name) : Symbol(std::string_view(name)) {}
+
+  SymbolId getId() const { return id; }
+  const std::string &str() const { return SymbolTable::global().name(id); }
+  bool empty() const { return id == 0; }
+
+  bool operator==(const Symbol &other) const { return id == other.id; }
+  bool operator!=(const Symbol &other) const { return id != other.id; }
+  bool operator<(const Symbol &other) const { return id < other.id; }
+
+private:
+  SymbolId id;
+};
+
+/*
+  Open addressing map keyed by symbol ids, the entries live in a single flat
+  array and a lookup is a multiplicative hash plus a short linear probe
+*/
+template <typename T> class SymbolMap {
+public:
+  typedef std::pair<Symbol, T> Entry;
+
+  class iterator {
+  public:
+    iterator(SymbolMap *map, size_t index) : map(map), index(index) { skip(); }
+
+    Entry &operator*() const { return map->entries[index]; }
+    Entry *operator->() const { return &map->entries[index]; }
+    iterator &operator++() {
+      index++;
+      skip();
+      return *this;
+    }
+    bool operator==(const iterator &other) const {
+      return index == other.index;
+    }
+    bool operator!=(const iterator &other) const {
+      return index != other.index;
+    }
+
+  private:
+    SymbolMap *map;
+    size_t index;
+
+    void skip() {
+      while (index < map->keys.size() && map->keys[index] == EMPTY)
+        index++;
+    }
+  };
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, keys.size()); }
+
+  iterator find(Symbol key) {
+    size_t slot = findSlot(key.getId());
+    return slot < keys.size() && keys[slot] != EMPTY ? iterator(this, slot)
+                                                     : end();
+  }
+
+  bool contains(Symbol key) const {
+    size_t slot = findSlot(key.getId());
+    return slot < keys.size() && keys[slot] != EMPTY;
+  }
+
+  // Returns the value or a default one, without inserting
+  T lookup(Symbol key) const {
+    size_t slot = findSlot(key.getId());
+    return slot < keys.size() && keys[slot] != EMPTY ? entries[slot].second
+                                                     : T{};
+  }
+
+  T &operator[](Symbol key) {
+    if ((count + 1) * 2 > keys.size())
+      grow();
+
+    size_t slot = findSlot(key.getId());
+    if (keys[slot] == EMPTY) {
+      keys[slot] = key.getId();
+      entries[slot] = Entry(key, T{});
+      count++;
+    }
+    return entries[slot].second;
+  }
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  void clear() {
+    keys.clear();
+    entries.clear();
+    count = 0;
+  }
+
+private:
+  static constexpr SymbolId EMPTY = UINT32_MAX;
+
+  std::vector<SymbolId> keys;
+  std::vector<Entry> entries;
+  size_t count = 0;
+
+  // Slot holding the key or the empty slot where it would be inserted
+  size_t findSlot(SymbolId key) const {
+    if (keys.empty())
+      return 0;
+
+    size_t mask = keys.size() - 1;
+    size_t slot = (key * 2654435769u) & mask;
+    while (keys[slot] != EMPTY && keys[slot] != key)
+      slot = (slot + 1) & mask;
+    return slot;
+  }
+
+  void grow() {
+    auto oldKeys = std::move(keys);
+    auto oldEntries = std::move(entries);
+
+    size_t capacity = oldKeys.empty() ? 8 : oldKeys.size() * 2;
+    keys.assign(capacity, EMPTY);
+    entries.assign(capacity, Entry());
+
+    for (size_t i = 0; i < oldKeys.size(); i++) {
+      if (oldKeys[i] == EMPTY)
+        continue;
+      size_t slot = findSlot(oldKeys[i]);
+      keys[slot] = oldKeys[i];
+      entries[slot] = std::move(oldEntries[i]);
+    }
+  }
+};
+
+namespace std {
+template <> struct hash<Symbol> {
+  size_t operator()(const Symbol &symbol) const { return symbol.getId(); }
+};
+} // namespace std
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef _visitor
+#define _visitor
+
+#include "ast.h"
+
+/*
+  Statically dispatched visitor. Derived hides the visit methods it handles,
+  the calls below are resolved at compile time and can be inlined, so there
+  is no virtual call per node. The hot passes (validator and assembler) use
+  it, the rest of them keep going through BaseVisitor.
+*/
+template <typename Derived> class StaticVisitor {
+public:
+  void visit(AstNode *node) {
+    auto self = static_cast<Derived *>(this);
+
+    switch (node->getNodeType()) {
+    case NodeType::PROGRAM:
+      return self->visitProgram(static_cast<ProgramNode *>(node));
+    case NodeType::FUNCTION:
+      return self->visitFunction(static_cast<FunctionNode *>(node));
+    case NodeType::STRUCT_DEF:
+      return self->visitStructDef(static_cast<StructDefNode *>(node));
+    case NodeType::BODY:
+      return self->visitBody(static_cast<BodyNode *>(node));
+    case NodeType::IF:
+      return self->visitIf(static_cast<IfNode *>(node));
+    case NodeType::WHILE:
+      return self->visitWhile(static_cast<WhileNode *>(node));
+    case NodeType::FOR:
+      return self->visitFor(static_cast<ForNode *>(node));
+    case NodeType::FUNCCALL:
+      return self->visitExprCall(static_cast<ExprCallNode *>(node));
+    case NodeType::BREAK:
+      return self->visitBreakNode(static_cast<BreakNode *>(node));
+    case NodeType::RETURN:
+      return self->visitReturnNode(static_cast<ReturnNode *>(node));
+    case NodeType::VAR_DEF:
+      return self->visitVarDef(static_cast<VarDefNode *>(node));
+    case NodeType::VAR_REF:
+      return self->visitExprVarRef(static_cast<ExprVarRefNode *>(node));
+    case NodeType::TYPE_DEF:
+      return self->visitTypeDefNode(static_cast<TypeDefNode *>(node));
+    case NodeType::EXPR_BINARY:
+      return self->visitExprBinaryOp(static_cast<ExprBinaryNode *>(node));
+    case NodeType::INDEX_ACCESS:
+      return self->visitIndexAccess(static_cast<ExprIndex *>(node));
+    case NodeType::MEMBER_ACCESS:
+      return self->visitMemberAccess(static_cast<ExprMemberAccess *>(node));
+    case NodeType::EXPR_UNARY:
+      return self->visitExprUnaryOp(static_cast<ExprUnaryNode *>(node));
+    case NodeType::EXPR_CONSTANT:
+      return self->visitExprConstant(static_cast<ExprConstantNode *>(node));
+    }
+  }
+
+  void visitChildren(AstNode *node) {
+    for (auto child : node->_children)
+      visit(child);
+  }
+
+  void visitProgram(ProgramNode *node) {}
+  void visitFunction(FunctionNode *node) {}
+  void visitBody(BodyNode *node) {}
+  void visitIf(IfNode *node) {}
+  void visitWhile(WhileNode *node) {}
+  void visitFor(ForNode *node) {}
+  void visitVarDef(VarDefNode *node) {}
+  void visitStructDef(StructDefNode *node) {}
+  void visitTypeDefNode(TypeDefNode *node) {}
+  void visitBreakNode(BreakNode *node) {}
+  void visitReturnNode(ReturnNode *node) {}
+
+  void visitExprBinaryOp(ExprBinaryNode *node) {}
+  void visitMemberAccess(ExprMemberAccess *node) {}
+  void visitIndexAccess(ExprIndex *node) {}
+  void visitExprCall(ExprCallNode *node) {}
+  void visitExprUnaryOp(ExprUnaryNode *node) {}
+
+  void visitExprVarRef(ExprVarRefNode *node) {}
+  void visitExprConstant(ExprConstantNode *node) {}
+};
+
+#endif
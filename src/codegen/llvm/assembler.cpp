@@ -1,6 +1,9 @@
 #include "assembler.h"
+#include "../../parser/parser.h"
+#include "shapes.h"
 #include <lld/Common/Driver.h>
 #include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DerivedTypes.h>
@@ -10,13 +13,19 @@
 #include <llvm/Support/CodeGen.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/TargetParser/Triple.h>
+#include <llvm/Transforms/Utils/FunctionComparator.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
 #include <ostream>
 #include <vector>
 
 using namespace llvm;
 
-Assembler::Assembler(bool withEntrypoint) {
+Assembler::Assembler(bool withEntrypoint, bool sharedGenerics) {
   this->withEntrypoint = withEntrypoint;
+  this->sharedGenerics = sharedGenerics;
 
   TheContext = new LLVMContext();
   Builder = new llvm::IRBuilder<>(*TheContext);
@@ -32,11 +41,15 @@ Assembler::Assembler(bool withEntrypoint) {
       {RawDataType::VOID, Type::getVoidTy(*TheContext)},
   };
 
-  llvm::InitializeAllTargetInfos();
-  llvm::InitializeAllTargets();
-  llvm::InitializeAllTargetMCs();
-  llvm::InitializeAllAsmParsers();
-  llvm::InitializeAllAsmPrinters();
+  // Once per process, every compilation of a batch shares the registry
+  static std::once_flag targetsInitialized;
+  std::call_once(targetsInitialized, [] {
+    llvm::InitializeAllTargetInfos();
+    llvm::InitializeAllTargets();
+    llvm::InitializeAllTargetMCs();
+    llvm::InitializeAllAsmParsers();
+    llvm::InitializeAllAsmPrinters();
+  });
 
   std::string Error;
   auto TargetTriple = LLVMGetDefaultTargetTriple();
@@ -56,12 +69,12 @@ Assembler::Assembler(bool withEntrypoint) {
   TheModule->setTargetTriple(TargetTriple);
 }
 
-std::stack<BasicBlock *> breakTo;
-std::map<VarDefNode *, std::pair<Type *, Value *>> varContextMap;
-std::map<std::string, StructType *> structTypeMap;
-std::map<FunctionNode *, Function *> functionMap;
-
-int funcCounter = 1;
+Assembler::~Assembler() {
+  TheModule.reset();
+  delete Builder;
+  delete TheContext;
+  delete target;
+}
 
 void Assembler::printAssembled(std::string filename) {
   if (!compiled) {
@@ -162,7 +175,7 @@ void Assembler::generateObject(std::string out, bool useAsm) {
 }
 
 Value *Assembler::loadValue(ExprNode *node) {
-  node->visit(this);
+  visit(node);
   if (node->type->raw == RawDataType::ARRAY ||
       node->type->raw == RawDataType::POINTER)
     return current;
@@ -177,17 +190,27 @@ Value *Assembler::loadValue(ExprNode *node) {
 }
 
 Type *Assembler::getType(DataType *type) {
+  auto mapped = llvmTypes.lookup(type);
+  if (!mapped) {
+    // Inner types are inserted while building, no reference survives that
+    mapped = buildType(type);
+    llvmTypes[type] = mapped;
+  }
+  return mapped;
+}
+
+Type *Assembler::buildType(DataType *type) {
   if (!type->inner && type->raw != RawDataType::STRUCT) {
     auto mapped = rawTypeMapper[type->raw];
     if (!mapped)
-      error("Invalid type " + type->ident);
+      error("Invalid type " + type->ident.str());
     return mapped;
   }
 
   if (type->raw == RawDataType::STRUCT) {
-    auto mappedStruct = structTypeMap[type->ident];
+    auto mappedStruct = structTypeMap.lookup(type->ident.getId());
     if (!mappedStruct)
-      error("Invalid struct " + type->ident);
+      error("Invalid struct " + type->ident.str());
 
     return mappedStruct;
   }
@@ -249,7 +272,7 @@ Value *Assembler::getCast(Value *value, DataType *original, DataType *castTo) {
 
 Value *Assembler::getCondition(ExprNode *node, bool isTrue) {
   if (node->type->raw == RawDataType::POINTER) {
-    node->visit(this);
+    visit(node);
     current = isTrue ? Builder->CreateIsNotNull(current)
                      : Builder->CreateIsNull(current);
     return current;
@@ -275,12 +298,12 @@ Value *Assembler::getCondition(ExprNode *node, bool isTrue) {
 void Assembler::visitProgram(ProgramNode *node) {
   program = node;
 
-  node->visitChildren(this);
+  visitChildren(node);
 
   if (withEntrypoint) {
     if (!main)
       error("Non-existing main function");
-    auto exitFuncDef = node->funcs["sys_exit"];
+    auto exitFuncDef = node->funcs.lookup("sys_exit");
     if (!exitFuncDef)
       error("libCDefiner has not been runned");
     auto exitFunc = functionMap[exitFuncDef];
@@ -291,12 +314,19 @@ void Assembler::visitProgram(ProgramNode *node) {
     auto startBlock = BasicBlock::Create(*TheContext, "startBlock", start);
     Builder->SetInsertPoint(startBlock);
     current = Builder->CreateCall(main, {}, "code");
-    auto statusCode = getCast(current, node->funcs[MAIN_FUNC]->retType,
+    auto statusCode = getCast(current, node->funcs.lookup(MAIN_FUNC)->retType,
                               DataType::build(RawDataType::INT));
     Builder->CreateCall(exitFunc, {statusCode});
     Builder->CreateRetVoid();
   }
 
+  if (sharedGenerics) {
+    ShapeSharing sharing(TheModule->getDataLayout());
+    for (auto func : sharedCandidates)
+      sharing.add(func);
+    sharing.run();
+  }
+
   compiled = true;
 }
 
@@ -316,19 +346,22 @@ void Assembler::defineFunction(FunctionNode *node) {
 
   auto funcType = FunctionType::get(retType, paramTypes, false);
 
-  auto funcName =
-      node->_externName.empty()
-          ? node->_name == MAIN_FUNC
-                ? MAIN_FUNC
-                : "func" + std::to_string(funcCounter++) + "_" + node->_name
-          : node->_externName;
-  auto func = Function::Create(funcType, Function::ExternalLinkage, funcName,
-                               *TheModule);
+  auto funcName = !node->_externName.empty() ? node->_externName
+                  : node->_name == MAIN_FUNC   ? MAIN_FUNC.str()
+                                               : mangle(node);
+  // Every object expands its own instances, they can not be shared by name
+  auto linkage =
+      isInstance(node) ? Function::InternalLinkage : Function::ExternalLinkage;
+  auto func = Function::Create(funcType, linkage, funcName, *TheModule);
 
   functionMap[node] = func;
 }
 
 void Assembler::visitFunction(FunctionNode *node) {
+  // Const functions only exist at compile time, generic ones per instance
+  if (node->_constant || !node->_genericArgNames.empty())
+    return;
+
   this->defineFunction(node);
 
   auto func = functionMap[node];
@@ -342,7 +375,7 @@ void Assembler::visitFunction(FunctionNode *node) {
   if (funcName == MAIN_FUNC)
     main = func;
 
-  auto block = BasicBlock::Create(*TheContext, node->_name, func);
+  auto block = BasicBlock::Create(*TheContext, node->_name.str(), func);
   Builder->SetInsertPoint(block);
 
   for (ulint i = 0; i < node->_params.size(); i++) {
@@ -350,22 +383,33 @@ void Assembler::visitFunction(FunctionNode *node) {
     auto paramDef = node->_params[i];
     auto paramType = getType(paramDef->type);
 
-    auto paramVar = Builder->CreateAlloca(paramType, nullptr, paramDef->_name);
+    auto paramVar =
+        Builder->CreateAlloca(paramType, nullptr, paramDef->_name.str());
 
     Builder->CreateStore(arg, paramVar);
     varContextMap[paramDef] = std::make_pair(paramType, paramVar);
   }
 
-  for (auto &[varName, varDef] : node->localVars) {
-    if (funcRegParams.find(varDef) != funcRegParams.end())
-      continue;
-
+  // In source order, symbol ids depend on what other files were read
+  std::vector<VarDefNode *> localVars;
+  for (auto &[_, varDef] : node->localVars)
+    if (funcRegParams.find(varDef) == funcRegParams.end())
+      localVars.push_back(varDef);
+  std::sort(localVars.begin(), localVars.end(),
+            [](VarDefNode *left, VarDefNode *right) {
+              auto l = left->_loc, r = right->_loc;
+              return l.getLine() != r.getLine() ? l.getLine() < r.getLine()
+                                                : l.getCol() < r.getCol();
+            });
+
+  for (auto varDef : localVars) {
     auto varType = getType(varDef->type);
-    auto allocVar = Builder->CreateAlloca(varType, nullptr, varName);
+    auto allocVar =
+        Builder->CreateAlloca(varType, nullptr, varDef->_name.str());
     varContextMap[varDef] = std::make_pair(varType, allocVar);
   }
 
-  node->_body->visit(this);
+  visit(node->_body);
   if (node->retType->raw == RawDataType::VOID) {
     if (!outWithReturn)
       Builder->CreateRetVoid();
@@ -376,32 +420,118 @@ void Assembler::visitFunction(FunctionNode *node) {
 
   function = nullptr;
   funcRegParams.clear();
+
+  if (isInstance(node))
+    shareInstanceBody(node, func);
+}
+
+static std::string withLength(std::string name) {
+  return std::to_string(name.size()) + name;
+}
+
+/*
+  _GU, the module, the struct of a method, the name and the parameter types.
+  The module is the file name without extension, as GUname.guh declares
+  what GUname.gu defines, so declarations and definitions agree in every
+  object whatever order they are visited in.
+*/
+std::string Assembler::mangle(FunctionNode *node) {
+  auto module = std::filesystem::path(node->_loc.getFileName()).stem();
+  std::string symbol = "_GU" + withLength(module.string());
+
+  auto parent = node->_parent;
+  if (parent && parent->getNodeType() == NodeType::STRUCT_DEF)
+    symbol += withLength(((StructDefNode *)parent)->_name.str());
+
+  symbol += withLength(node->_name.str());
+  for (auto param : node->_params)
+    symbol += mangleType(param->type);
+  return symbol;
+}
+
+std::string Assembler::mangleType(DataType *type) {
+  switch (type->raw) {
+  case RawDataType::CHAR:
+    return "c";
+  case RawDataType::SHORT:
+    return "s";
+  case RawDataType::INT:
+    return "i";
+  case RawDataType::LONG:
+    return "l";
+  case RawDataType::FLOAT:
+    return "f";
+  case RawDataType::DOUBLE:
+    return "d";
+  case RawDataType::POINTER:
+    return "P" + mangleType(type->inner);
+  case RawDataType::ARRAY:
+    return "A" + std::to_string(type->arrLength) + "_" +
+           mangleType(type->inner);
+  case RawDataType::STRUCT:
+    return withLength(type->ident.str());
+  default:
+    return "v";
+  }
+}
+
+bool Assembler::isInstance(FunctionNode *node) {
+  if (node->_genericOf)
+    return true;
+  auto parent = node->_parent;
+  return parent && parent->getNodeType() == NodeType::STRUCT_DEF &&
+         ((StructDefNode *)parent)->_genericOf;
+}
+
+// Instances that lowered to the same code, as pointers to different types or
+// structs with the same layout do, keep only the body of the first one
+void Assembler::shareInstanceBody(FunctionNode *node, Function *func) {
+  auto &candidates = instanceBodies[FunctionComparator::functionHash(*func)];
+  for (auto candidate : candidates) {
+    if (FunctionComparator(candidate, func, &globalNumbers).compare())
+      continue;
+
+    func->replaceAllUsesWith(candidate);
+    func->eraseFromParent();
+    functionMap[node] = candidate;
+    return;
+  }
+  candidates.push_back(func);
+
+  if (sharedGenerics && !node->_hot)
+    sharedCandidates.push_back(func);
 }
 
 void Assembler::visitStructDef(StructDefNode *node) {
   if (!node->_genericArgNames.empty())
     return;
 
-  auto structType = StructType::create(*TheContext, node->_name);
-  structTypeMap[node->_name] = structType;
+  auto structType = StructType::create(*TheContext, node->_name.str());
+  structTypeMap[node->_name.getId()] = structType;
 
+  // Members are laid out in declaration order, matching membersOffset
   std::vector<Type *> memberTypes;
-  for (auto &[_, memberDef] : node->membersDef)
-    memberTypes.push_back(getType(memberDef->type));
+  std::vector<FunctionNode *> funcMembers;
+  for (auto member : node->_members) {
+    if (member->getNodeType() == NodeType::VAR_DEF)
+      memberTypes.push_back(getType(((VarDefNode *)member)->type));
+    else
+      funcMembers.push_back((FunctionNode *)member);
+  }
   structType->setBody(memberTypes);
 
-  for (auto &[_, funcNode] : node->funcMembers)
+  for (auto funcNode : funcMembers)
     defineFunction(funcNode);
 
-  for (auto &[_, funcNode] : node->funcMembers)
-    funcNode->visit(this);
+  for (auto funcNode : funcMembers)
+    visit(funcNode);
 }
 
 void Assembler::visitBody(BodyNode *node) {
   outWithReturn = false;
 
   for (auto &statement : node->_statements) {
-    statement->visit(this);
+    visit(statement);
     if (statement->getNodeType() == NodeType::RETURN) {
       outWithReturn = true;
       break;
@@ -419,7 +549,7 @@ void Assembler::visitIf(IfNode *node) {
   Builder->CreateCondBr(condition, ifBlock, elseBlock);
 
   Builder->SetInsertPoint(ifBlock);
-  node->_ifBody->visit(this);
+  visit(node->_ifBody);
 
   bool ifWithReturn = outWithReturn;
   bool elseWithReturn = false;
@@ -434,7 +564,7 @@ void Assembler::visitIf(IfNode *node) {
 
   if (node->_elseBody) {
     Builder->SetInsertPoint(elseBlock);
-    node->_elseBody->visit(this);
+    visit(node->_elseBody);
     elseWithReturn = outWithReturn;
     if (!elseWithReturn) {
       if (!endBlock)
@@ -467,7 +597,7 @@ void Assembler::visitWhile(WhileNode *node) {
   Builder->CreateCondBr(condition, loopBlock, endBlock);
 
   Builder->SetInsertPoint(loopBlock);
-  node->_body->visit(this);
+  visit(node->_body);
   Builder->CreateBr(testBlock);
 
   outWithReturn = false;
@@ -485,7 +615,7 @@ void Assembler::visitFor(ForNode *node) {
   breakTo.push(endBlock);
 
   if (node->_start)
-    node->_start->visit(this);
+    visit(node->_start);
 
   Builder->CreateBr(testBlock);
 
@@ -498,11 +628,11 @@ void Assembler::visitFor(ForNode *node) {
     Builder->CreateBr(loopBlock);
 
   Builder->SetInsertPoint(loopBlock);
-  node->_body->visit(this);
+  visit(node->_body);
   outWithReturn = false;
 
   if (node->_inc)
-    node->_inc->visit(this);
+    visit(node->_inc);
   Builder->CreateBr(testBlock);
 
   Builder->SetInsertPoint(endBlock);
@@ -514,14 +644,25 @@ void Assembler::visitVarDef(VarDefNode *node) {
   if (!function) {
     Value *constant = nullptr;
     if (node->_defaultVal) {
-      node->_defaultVal->visit(this);
+      visit(node->_defaultVal);
       constant = current;
     }
 
+    // Folded constants of an executable can not be referenced from outside,
+    // declared ones get a copy as their object may not define them
+    auto linkage = GlobalValue::ExternalLinkage;
+    if ((withEntrypoint || node->_external) && node->_constant &&
+        !node->_export && constant &&
+        (DataType::isNumeric(node->type->raw) ||
+         node->type->raw == RawDataType::ARRAY))
+      linkage = GlobalValue::PrivateLinkage;
+
     auto varType = getType((node->type));
-    auto globalVar = new GlobalVariable(*TheModule, varType, node->_constant,
-                                        GlobalValue::ExternalLinkage,
-                                        (Constant *)constant, node->_name);
+    auto globalVar =
+        new GlobalVariable(*TheModule, varType, node->_constant, linkage,
+                           (Constant *)constant, node->_name.str());
+    if (linkage == GlobalValue::PrivateLinkage)
+      globalVar->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
 
     varContextMap[node] = std::make_pair(varType, globalVar);
     return;
@@ -529,8 +670,8 @@ void Assembler::visitVarDef(VarDefNode *node) {
 
   if (!node->_defaultVal) {
     if (!node->_initArgs.empty()) {
-      auto structDef = program->structDefs[node->type->ident];
-      auto initFunc = functionMap[structDef->funcMembers[INIT_FUNC]];
+      auto structDef = program->structDefs.lookup(node->type->ident);
+      auto initFunc = functionMap[structDef->funcMembers.lookup(INIT_FUNC)];
       std::vector<Value *> args;
       for (auto arg : node->_initArgs) {
         current = loadValue(arg);
@@ -571,12 +712,12 @@ void Assembler::visitReturnNode(ReturnNode *node) {
 }
 
 void Assembler::visitMemberAccess(ExprMemberAccess *node) {
-  node->_struct->visit(this);
-  auto structType = structTypeMap[node->structDef->_name];
-  auto offset = node->structDef->membersOffset[node->_memberName];
+  visit(node->_struct);
+  auto structType = structTypeMap.lookup(node->structDef->_name.getId());
+  auto offset = node->structDef->membersOffset.lookup(node->_memberName);
 
-  current =
-      Builder->CreateStructGEP(structType, current, offset, node->_memberName);
+  current = Builder->CreateStructGEP(structType, current, offset,
+                                     node->_memberName.str());
 }
 
 void Assembler::visitIndexAccess(ExprIndex *node) {
@@ -595,11 +736,14 @@ void Assembler::visitIndexAccess(ExprIndex *node) {
 void Assembler::visitExprCall(ExprCallNode *node) {
   if (node->_ref->getNodeType() == NodeType::VAR_REF) {
     auto varRef = (ExprVarRefNode *)node->_ref;
-    if (varRef->_ident == "sizeof") {
+    if (varRef->_ident == SIZEOF_FUNC) {
       return visitSizeof(node);
     }
   }
 
+  if (node->func->_constant)
+    error("Const function call was not evaluated");
+
   std::vector<Value *> args;
   for (ulint i = 0; i < node->_args.size(); i++) {
     auto loadedValue = loadValue(node->_args[i]);
@@ -619,10 +763,12 @@ void Assembler::visitSizeof(ExprCallNode *node) {
   Type *type;
   if (varRef->var) {
     type = varContextMap[varRef->var].first;
+  } else if (varRef->type->raw == RawDataType::STRUCT) {
+    type = structTypeMap.lookup(varRef->type->ident.getId());
   } else {
-    type = structTypeMap[varRef->type->ident];
+    type = getType(varRef->type);
   }
-  if (!type)
+  if (!type || !type->isSized())
     error("Invalid sizeof");
 
   auto dataLayout = TheModule->getDataLayout();
@@ -634,14 +780,14 @@ void Assembler::visitExprUnaryOp(ExprUnaryNode *node) {
   auto exprType = getType(node->_expr->type);
   Value *exprValue;
 
-  switch (node->_op[0]) {
-  case '-':
+  switch (node->_op) {
+  case ExprOperator::MINUS:
     exprValue = loadValue(node->_expr);
     current = DataType::isFloat(node->_expr->type->raw)
                   ? Builder->CreateFNeg(exprValue)
                   : Builder->CreateNeg(exprValue);
     break;
-  case '+': {
+  case ExprOperator::PLUS: {
     exprValue = loadValue(node->_expr);
     auto zero = getZero(node->_expr->type);
 
@@ -655,17 +801,17 @@ void Assembler::visitExprUnaryOp(ExprUnaryNode *node) {
         Builder->CreateSelect(isNegative, negated, exprValue, "absolute value");
     break;
   }
-  case '*':
+  case ExprOperator::MULT:
     exprValue = loadValue(node->_expr);
     current = Builder->CreateLoad(exprType, exprValue, "derreferenced");
     break;
-  case '&': {
-    node->_expr->visit(this);
+  case ExprOperator::B_AND: {
+    visit(node->_expr);
     break;
   }
-  case '!': {
+  case ExprOperator::NOT: {
     if (node->_expr->type->raw == RawDataType::POINTER) {
-      node->_expr->visit(this);
+      visit(node->_expr);
       current = Builder->CreateIsNull(current);
       break;
     }
@@ -683,6 +829,8 @@ void Assembler::visitExprUnaryOp(ExprUnaryNode *node) {
     current = Builder->CreateSelect(isZero, one32, zero32);
     break;
   }
+  default:
+    error("Invalid unary operator");
   }
 }
 
@@ -699,16 +847,12 @@ void Assembler::visitExprConstant(ExprConstantNode *node) {
   if (rawTypeMapper.find(node->type->raw) != rawTypeMapper.end()) {
     auto type = rawTypeMapper[node->type->raw];
     if (type->isFloatingPointTy()) {
-      double value = std::stod(node->_rawValue);
+      double value = node->_isFloat ? node->_floatValue
+                                    : (double)(int64_t)node->_intValue;
       current = ConstantFP::get(type, value);
     } else {
-      std::string strVal = "";
-      for (char c : node->_rawValue) {
-        if (c == '.')
-          break;
-        strVal += c;
-      }
-      long value = std::stoi(strVal);
+      uint64_t value =
+          node->_isFloat ? (int64_t)node->_floatValue : node->_intValue;
       current = ConstantInt::get(type, value);
     }
 
@@ -716,185 +860,57 @@ void Assembler::visitExprConstant(ExprConstantNode *node) {
   }
 
   if (node->type->raw == RawDataType::POINTER) {
-    if (node->_rawValue == "0") {
+    if (node->_rawType != LEX_STRING && node->_intValue == 0) {
       current = ConstantPointerNull::get((PointerType *)getType(node->type));
       return;
     }
 
     auto stringPtr = ConstantDataArray::getString(*TheContext, node->_rawValue);
-    current =
+    auto literal =
         new GlobalVariable(*TheModule, stringPtr->getType(), true,
-                           GlobalValue::ExternalLinkage, stringPtr, "string");
+                           GlobalValue::PrivateLinkage, stringPtr, "string");
+    literal->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+    current = literal;
   } else if (node->type->raw == RawDataType::ARRAY) {
+    if (node->_rawType != LEX_STRING) {
+      const uint64_t *element = node->elements.data();
+      current = getConstantArray(node->type, element);
+      return;
+    }
+
     current = ConstantDataArray::getString(*TheContext, node->_rawValue);
   }
 }
 
+Constant *Assembler::getConstantArray(DataType *type,
+                                      const uint64_t *&element) {
+  std::vector<Constant *> values;
+  values.reserve(type->arrLength);
+
+  auto inner = type->inner;
+  for (ulint i = 0; i < type->arrLength; i++) {
+    if (inner->raw == RawDataType::ARRAY) {
+      values.push_back(getConstantArray(inner, element));
+      continue;
+    }
+
+    uint64_t bits = *element++;
+    if (DataType::isFloat(inner->raw)) {
+      double value;
+      std::memcpy(&value, &bits, sizeof value);
+      values.push_back(ConstantFP::get(getType(inner), value));
+    } else
+      values.push_back(ConstantInt::get(getType(inner), bits));
+  }
+
+  // Arrays of plain numbers end up as a ConstantDataArray
+  return ConstantArray::get((ArrayType *)getType(type), values);
+}
+
 void Assembler::visitExprBinaryOp(ExprBinaryNode *node) {
-  static std::map<std::string,
-                  std::function<void(ExprBinaryNode *, Value *, Value *)>>
-      binaryOpHandlers = {
-          {"+",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             if (DataType::isFloat(node->type->raw))
-               current = Builder->CreateFAdd(left, right);
-             else
-               current = Builder->CreateAdd(left, right);
-           }},
-          {"-",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             if (DataType::isFloat(node->type->raw))
-               current = Builder->CreateFSub(left, right);
-             else
-               current = Builder->CreateSub(left, right);
-           }},
-          {"*",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             if (DataType::isFloat(node->type->raw))
-               current = Builder->CreateFMul(left, right);
-             else
-               current = Builder->CreateMul(left, right);
-           }},
-          {"/",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             if (DataType::isFloat(node->type->raw))
-               current = Builder->CreateFDiv(left, right);
-             else
-               current = Builder->CreateSDiv(left, right);
-           }},
-          {"%",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             if (DataType::isFloat(node->type->raw))
-               current = Builder->CreateFRem(left, right, "add");
-             else
-               current = Builder->CreateSRem(left, right);
-           }},
-          {">>",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             current = Builder->CreateAShr(left, right);
-           }},
-          {"<<",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             current = Builder->CreateShl(left, right);
-           }},
-          {">",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             auto zero = getZero(node->type);
-             auto one = getOne(node->type);
-             auto isGreater = DataType::isFloat(node->type->raw)
-                                  ? Builder->CreateFCmpOGT(left, right)
-                                  : Builder->CreateICmpSGT(left, right);
-             current = Builder->CreateSelect(isGreater, one, zero);
-
-             current = Builder->CreateZExt(current, getType(node->type));
-           }},
-          {"<",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             auto zero = getZero(node->type);
-             auto one = getOne(node->type);
-             auto isGreater = DataType::isFloat(node->type->raw)
-                                  ? Builder->CreateFCmpOLT(left, right)
-                                  : Builder->CreateICmpSLT(left, right);
-             current = Builder->CreateSelect(isGreater, one, zero);
-
-             current = Builder->CreateZExt(current, getType(node->type));
-           }},
-          {">=",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             auto zero = getZero(node->type);
-             auto one = getOne(node->type);
-             auto isGreater = DataType::isFloat(node->type->raw)
-                                  ? Builder->CreateFCmpOGE(left, right)
-                                  : Builder->CreateICmpSGE(left, right);
-             current = Builder->CreateSelect(isGreater, one, zero);
-
-             current = Builder->CreateZExt(current, getType(node->type));
-           }},
-          {"<=",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             auto zero = getZero(node->type);
-             auto one = getOne(node->type);
-             auto isGreater = DataType::isFloat(node->type->raw)
-                                  ? Builder->CreateFCmpOLE(left, right)
-                                  : Builder->CreateICmpSLE(left, right);
-             current = Builder->CreateSelect(isGreater, one, zero);
-
-             current = Builder->CreateZExt(current, getType(node->type));
-           }},
-          {"==",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             auto zero = getZero(node->type);
-             auto one = getOne(node->type);
-             auto isGreater = DataType::isFloat(node->type->raw)
-                                  ? Builder->CreateFCmpOEQ(left, right)
-                                  : Builder->CreateICmpEQ(left, right);
-             current = Builder->CreateSelect(isGreater, one, zero);
-
-             current = Builder->CreateZExt(current, getType(node->type));
-           }},
-          {"!=",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             auto zero = getZero(node->type);
-             auto one = getOne(node->type);
-             auto isGreater = DataType::isFloat(node->type->raw)
-                                  ? Builder->CreateFCmpONE(left, right)
-                                  : Builder->CreateICmpNE(left, right);
-             current = Builder->CreateSelect(isGreater, one, zero);
-             current = Builder->CreateZExt(current, getType(node->type));
-           }},
-          {"&&",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             auto zero = getZero(node->type);
-
-             auto leftNonZero = DataType::isFloat(node->type->raw)
-                                    ? Builder->CreateFCmpONE(left, zero)
-                                    : Builder->CreateICmpNE(left, zero);
-             auto rightNonZero = DataType::isFloat(node->type->raw)
-                                     ? Builder->CreateFCmpONE(right, zero)
-                                     : Builder->CreateICmpNE(right, zero);
-
-             leftNonZero =
-                 Builder->CreateZExt(leftNonZero, getType(node->type));
-             rightNonZero =
-                 Builder->CreateZExt(rightNonZero, getType(node->type));
-
-             current = Builder->CreateAnd(leftNonZero, rightNonZero);
-           }},
-          {"||",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             auto zero = getZero(node->type);
-
-             auto leftNonZero = DataType::isFloat(node->type->raw)
-                                    ? Builder->CreateFCmpONE(left, zero)
-                                    : Builder->CreateICmpNE(left, zero);
-             auto rightNonZero = DataType::isFloat(node->type->raw)
-                                     ? Builder->CreateFCmpONE(right, zero)
-                                     : Builder->CreateICmpNE(right, zero);
-
-             leftNonZero =
-                 Builder->CreateZExt(leftNonZero, getType(node->type));
-             rightNonZero =
-                 Builder->CreateZExt(rightNonZero, getType(node->type));
-
-             current = Builder->CreateOr(leftNonZero, rightNonZero);
-           }},
-          {"&",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             current = Builder->CreateAnd(left, right);
-           }},
-          {"|",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             current = Builder->CreateOr(left, right);
-           }},
-          {"^",
-           [this](ExprBinaryNode *node, Value *left, Value *right) {
-             current = Builder->CreateXor(left, right);
-           }},
-      };
-
-  if (node->_op == "=") {
+  if (node->_op == ExprOperator::ASSIGN) {
     auto rightVal = loadValue(node->_right);
-    node->_left->visit(this);
+    visit(node->_left);
     auto leftPtr = current;
     auto casted = getCast(rightVal, node->_right->type, node->_left->type);
     Builder->CreateStore(casted, leftPtr);
@@ -908,11 +924,96 @@ void Assembler::visitExprBinaryOp(ExprBinaryNode *node) {
   auto castTo = DataType::getOperationType(node->_left->type, node->_op,
                                            node->_right->type);
 
-  auto leftCasted = getCast(leftVal, node->_left->type, castTo);
-  auto rightCasted = getCast(rightVal, node->_right->type, castTo);
+  auto left = getCast(leftVal, node->_left->type, castTo);
+  auto right = getCast(rightVal, node->_right->type, castTo);
+  bool isFloat = DataType::isFloat(node->type->raw);
 
-  auto handler = binaryOpHandlers[node->_op];
-  handler(node, leftCasted, rightCasted);
+  auto selectFlag = [&](Value *flag) {
+    auto zero = getZero(node->type);
+    auto one = getOne(node->type);
+    current = Builder->CreateSelect(flag, one, zero);
+    current = Builder->CreateZExt(current, getType(node->type));
+  };
+
+  switch (node->_op) {
+  case ExprOperator::PLUS:
+    current = isFloat ? Builder->CreateFAdd(left, right)
+                      : Builder->CreateAdd(left, right);
+    break;
+  case ExprOperator::MINUS:
+    current = isFloat ? Builder->CreateFSub(left, right)
+                      : Builder->CreateSub(left, right);
+    break;
+  case ExprOperator::MULT:
+    current = isFloat ? Builder->CreateFMul(left, right)
+                      : Builder->CreateMul(left, right);
+    break;
+  case ExprOperator::DIV:
+    current = isFloat ? Builder->CreateFDiv(left, right)
+                      : Builder->CreateSDiv(left, right);
+    break;
+  case ExprOperator::MOD:
+    current = isFloat ? Builder->CreateFRem(left, right, "add")
+                      : Builder->CreateSRem(left, right);
+    break;
+  case ExprOperator::B_RSHIFT:
+    current = Builder->CreateAShr(left, right);
+    break;
+  case ExprOperator::B_LSHIFT:
+    current = Builder->CreateShl(left, right);
+    break;
+  case ExprOperator::GT:
+    selectFlag(isFloat ? Builder->CreateFCmpOGT(left, right)
+                       : Builder->CreateICmpSGT(left, right));
+    break;
+  case ExprOperator::LT:
+    selectFlag(isFloat ? Builder->CreateFCmpOLT(left, right)
+                       : Builder->CreateICmpSLT(left, right));
+    break;
+  case ExprOperator::GTE:
+    selectFlag(isFloat ? Builder->CreateFCmpOGE(left, right)
+                       : Builder->CreateICmpSGE(left, right));
+    break;
+  case ExprOperator::LTE:
+    selectFlag(isFloat ? Builder->CreateFCmpOLE(left, right)
+                       : Builder->CreateICmpSLE(left, right));
+    break;
+  case ExprOperator::EQ:
+    selectFlag(isFloat ? Builder->CreateFCmpOEQ(left, right)
+                       : Builder->CreateICmpEQ(left, right));
+    break;
+  case ExprOperator::NEQ:
+    selectFlag(isFloat ? Builder->CreateFCmpONE(left, right)
+                       : Builder->CreateICmpNE(left, right));
+    break;
+  case ExprOperator::AND:
+  case ExprOperator::OR: {
+    auto zero = getZero(node->type);
+    auto leftNonZero = isFloat ? Builder->CreateFCmpONE(left, zero)
+                               : Builder->CreateICmpNE(left, zero);
+    auto rightNonZero = isFloat ? Builder->CreateFCmpONE(right, zero)
+                                : Builder->CreateICmpNE(right, zero);
+
+    leftNonZero = Builder->CreateZExt(leftNonZero, getType(node->type));
+    rightNonZero = Builder->CreateZExt(rightNonZero, getType(node->type));
+
+    current = node->_op == ExprOperator::AND
+                  ? Builder->CreateAnd(leftNonZero, rightNonZero)
+                  : Builder->CreateOr(leftNonZero, rightNonZero);
+    break;
+  }
+  case ExprOperator::B_AND:
+    current = Builder->CreateAnd(left, right);
+    break;
+  case ExprOperator::B_OR:
+    current = Builder->CreateOr(left, right);
+    break;
+  case ExprOperator::B_XOR:
+    current = Builder->CreateXor(left, right);
+    break;
+  default:
+    error("Invalid binary operator");
+  }
 }
 
 void Assembler::error(std::string err) {
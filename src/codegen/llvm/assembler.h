@@ -2,10 +2,12 @@
 #define _assembler
 
 #include "../../ast/ast.h"
+#include "../../ast/visitor.h"
 #include <elf.h>
 #include <functional>
 #include <lld/Common/CommonLinkerContext.h>
 #include <lld/Common/Driver.h>
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/ADT/STLExtras.h>
 #include <llvm/ADT/SmallVector.h>
 #include <llvm/CodeGen/CommandFlags.h>
@@ -46,15 +48,17 @@
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Utils/FunctionComparator.h>
 #include <memory>
 #include <set>
 #include <stack>
 #include <string>
 #include <utility>
 
-class Assembler : public BaseVisitor {
+class Assembler : public StaticVisitor<Assembler> {
 public:
-  Assembler(bool withEntrypoint);
+  Assembler(bool withEntrypoint, bool sharedGenerics = false);
+  ~Assembler();
 
   void optimize(char optLevel);
   void printAssembled(std::string filename = "");
@@ -93,22 +97,44 @@ private:
   ProgramNode *program;
   bool compiled = false;
   bool withEntrypoint;
+  bool sharedGenerics;
   bool outWithReturn = false;
 
   llvm::TargetMachine *target;
   llvm::Function *main = nullptr;
   llvm::Function *function = nullptr;
   std::set<VarDefNode *> funcRegParams;
+  std::vector<llvm::Function *> sharedCandidates;
+
+  // Everything lowered so far, owned by this instance so assemblers on
+  // different threads never share state
+  llvm::DenseMap<DataType *, llvm::Type *> llvmTypes;
+  llvm::DenseMap<SymbolId, llvm::StructType *> structTypeMap;
+  llvm::DenseMap<FunctionNode *, llvm::Function *> functionMap;
+  llvm::DenseMap<VarDefNode *, std::pair<llvm::Type *, llvm::Value *>>
+      varContextMap;
+  std::stack<llvm::BasicBlock *> breakTo;
+  // Function hashes can be any 64-bit value, DenseMap reserves two of them
+  std::map<llvm::FunctionComparator::FunctionHash,
+           std::vector<llvm::Function *>>
+      instanceBodies;
+  llvm::GlobalNumberState globalNumbers;
 
   void defineFunction(FunctionNode *node);
+  std::string mangle(FunctionNode *node);
+  std::string mangleType(DataType *type);
+  void shareInstanceBody(FunctionNode *node, llvm::Function *func);
+  bool isInstance(FunctionNode *node);
 
   llvm::Type *getType(DataType *type);
+  llvm::Type *buildType(DataType *type);
   llvm::Value *loadValue(ExprNode *node);
   llvm::Value *getZero(DataType *type);
   llvm::Value *getOne(DataType *type);
   llvm::Value *getCast(llvm::Value *value, DataType *original,
                        DataType *castTo);
   llvm::Value *getCondition(ExprNode *node, bool isTrue = true);
+  llvm::Constant *getConstantArray(DataType *type, const uint64_t *&element);
   llvm::Value *current;
 
   void error(std::string msg);
@@ -0,0 +1,286 @@
+#include "shapes.h"
+#include <llvm/IR/GetElementPtrTypeIterator.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+#include <algorithm>
+#include <set>
+#include <tuple>
+
+using namespace llvm;
+
+void ShapeSharing::add(Function *func) { candidates.push_back(func); }
+
+int ShapeSharing::run() {
+  for (auto func : candidates)
+    flattenAddresses(func);
+
+  // Callers of merged instances pass the constants in the calls once the
+  // thunks are bypassed, so they may be merged in the next round
+  int shared = 0;
+  for (bool merged = true; merged;) {
+    merged = false;
+
+    std::map<FunctionComparator::FunctionHash, std::vector<Function *>> groups;
+    for (auto func : candidates)
+      groups[FunctionComparator::functionHash(*func)].push_back(func);
+
+    std::vector<Shape> shapes;
+    for (auto &[_, group] : groups) {
+      while (!group.empty()) {
+        Shape shape{group[0], {{group[0], {}}}};
+        std::vector<Function *> rest;
+        for (size_t i = 1; i < group.size(); i++) {
+          Member member{group[i], {}};
+          if (sameShape(group[0], group[i], member))
+            shape.members.push_back(std::move(member));
+          else
+            rest.push_back(group[i]);
+        }
+        if (shape.members.size() > 1)
+          shapes.push_back(std::move(shape));
+        group = std::move(rest);
+      }
+    }
+
+    for (auto &shape : shapes) {
+      if (!share(shape))
+        continue;
+      merged = true;
+      shared += shape.members.size();
+      for (auto &member : shape.members)
+        candidates.erase(
+            std::find(candidates.begin(), candidates.end(), member.func));
+    }
+  }
+
+  return shared;
+}
+
+// Every address becomes a byte offset from its base, so instances with the
+// same code over differently sized types only differ in the offsets
+void ShapeSharing::flattenAddresses(Function *func) {
+  std::vector<GetElementPtrInst *> geps;
+  for (auto &block : *func)
+    for (auto &inst : block)
+      if (auto gep = dyn_cast<GetElementPtrInst>(&inst))
+        geps.push_back(gep);
+
+  auto byteType = Type::getInt8Ty(func->getContext());
+  for (auto gep : geps) {
+    IRBuilder<> builder(gep);
+    auto indexType = layout.getIndexType(gep->getPointerOperandType());
+    uint64_t offset = 0;
+    Value *variable = nullptr;
+
+    for (auto it = gep_type_begin(gep); it != gep_type_end(gep); ++it) {
+      auto index = it.getOperand();
+      if (auto structType = it.getStructTypeOrNull()) {
+        auto field = cast<ConstantInt>(index)->getZExtValue();
+        offset += layout.getStructLayout(structType)->getElementOffset(field);
+        continue;
+      }
+
+      auto size = layout.getTypeAllocSize(it.getIndexedType()).getFixedValue();
+      if (auto constant = dyn_cast<ConstantInt>(index)) {
+        offset += constant->getSExtValue() * size;
+        continue;
+      }
+      auto scaled =
+          builder.CreateMul(builder.CreateSExtOrTrunc(index, indexType),
+                            ConstantInt::get(indexType, size));
+      variable = variable ? builder.CreateAdd(variable, scaled) : scaled;
+    }
+
+    Value *address = gep->getPointerOperand();
+    if (variable)
+      address = gep->isInBounds()
+                    ? builder.CreateInBoundsGEP(byteType, address, variable)
+                    : builder.CreateGEP(byteType, address, variable);
+    address = GetElementPtrInst::Create(
+        byteType, address, {ConstantInt::get(indexType, offset)}, "", gep);
+    ((GetElementPtrInst *)address)->setIsInBounds(gep->isInBounds());
+
+    address = builder.CreatePointerCast(address, gep->getType());
+    address->takeName(gep);
+    gep->replaceAllUsesWith(address);
+    gep->eraseFromParent();
+  }
+}
+
+bool ShapeSharing::isHiddenOperand(Instruction *inst, unsigned operand) {
+  if (isa<BinaryOperator>(inst) || isa<ICmpInst>(inst) || isa<ReturnInst>(inst))
+    return true;
+  if (isa<StoreInst>(inst))
+    return operand == 0;
+  if (isa<SelectInst>(inst))
+    return operand > 0;
+  if (auto call = dyn_cast<CallInst>(inst))
+    return !isa<IntrinsicInst>(call) && operand < call->arg_size();
+  if (auto gep = dyn_cast<GetElementPtrInst>(inst))
+    return operand == 1 && gep->getNumIndices() == 1 &&
+           gep->getSourceElementType()->isIntegerTy(8);
+  return false;
+}
+
+// Walks both bodies in lockstep recording the integer constants that may
+// become parameters, then compares them with those constants put back
+bool ShapeSharing::sameShape(Function *left, Function *right,
+                             Member &member) {
+  if (left->size() != right->size())
+    return false;
+
+  // Uses of the right function with the constant each one had and the one
+  // of the left function it takes while comparing
+  std::vector<std::tuple<Use *, Constant *, Constant *>> patched;
+  for (auto leftBlock = left->begin(), rightBlock = right->begin();
+       leftBlock != left->end(); ++leftBlock, ++rightBlock) {
+    if (leftBlock->size() != rightBlock->size())
+      return false;
+
+    for (auto leftInst = leftBlock->begin(), rightInst = rightBlock->begin();
+         leftInst != leftBlock->end(); ++leftInst, ++rightInst) {
+      if (leftInst->getOpcode() != rightInst->getOpcode() ||
+          leftInst->getNumOperands() != rightInst->getNumOperands())
+        return false;
+
+      for (unsigned i = 0; i < leftInst->getNumOperands(); i++) {
+        auto leftConst = dyn_cast<ConstantInt>(leftInst->getOperand(i));
+        auto rightConst = dyn_cast<ConstantInt>(rightInst->getOperand(i));
+        if (!leftConst || !rightConst || leftConst == rightConst)
+          continue;
+        if (leftConst->getType() != rightConst->getType() ||
+            !isHiddenOperand(&*leftInst, i))
+          return false;
+
+        member.constants[{&*leftInst, i}] = rightConst;
+        patched.push_back(
+            {&rightInst->getOperandUse(i), rightConst, leftConst});
+      }
+    }
+  }
+
+  for (auto &[use, own, shared] : patched)
+    use->set(shared);
+  bool same = FunctionComparator(left, right, &globalNumbers).compare() == 0;
+  for (auto &[use, own, shared] : patched)
+    use->set(own);
+
+  return same;
+}
+
+// The shared body is a copy of the representative taking the differing
+// constants as trailing parameters, every member becomes a call to it
+bool ShapeSharing::share(Shape &shape) {
+  auto representative = shape.representative;
+
+  std::set<Position> differing;
+  for (auto &member : shape.members)
+    for (auto &[position, _] : member.constants)
+      differing.insert(position);
+
+  // Parameters follow the order of the instructions, not of the pointers
+  std::vector<Position> positions;
+  for (auto &block : *representative)
+    for (auto &inst : block)
+      for (unsigned i = 0; i < inst.getNumOperands(); i++)
+        if (differing.count({&inst, i}))
+          positions.push_back({&inst, i});
+
+  // Positions holding the same constant in every member share a parameter
+  std::vector<std::vector<Value *>> columns;
+  std::vector<size_t> paramOf;
+  for (auto &position : positions) {
+    std::vector<Value *> column;
+    for (auto &member : shape.members) {
+      auto found = member.constants.find(position);
+      column.push_back(found != member.constants.end()
+                           ? found->second
+                           : position.inst->getOperand(position.operand));
+    }
+    auto found = std::find(columns.begin(), columns.end(), column);
+    paramOf.push_back(found - columns.begin());
+    if (found == columns.end())
+      columns.push_back(std::move(column));
+  }
+
+  size_t instructions = representative->getInstructionCount();
+  if (instructions <= representative->arg_size() + columns.size() + 2)
+    return false;
+
+  std::vector<Type *> paramTypes(
+      representative->getFunctionType()->param_begin(),
+      representative->getFunctionType()->param_end());
+  for (auto &column : columns)
+    paramTypes.push_back(column[0]->getType());
+
+  auto sharedFunc = Function::Create(
+      FunctionType::get(representative->getReturnType(), paramTypes, false),
+      Function::InternalLinkage, representative->getName() + ".shape",
+      representative->getParent());
+
+  ValueToValueMapTy valueMap;
+  for (size_t i = 0; i < representative->arg_size(); i++)
+    valueMap[representative->getArg(i)] = sharedFunc->getArg(i);
+  SmallVector<ReturnInst *, 8> returns;
+  CloneFunctionInto(sharedFunc, representative, valueMap,
+                    CloneFunctionChangeType::LocalChangesOnly, returns);
+
+  for (size_t i = 0; i < positions.size(); i++)
+    cast<Instruction>(valueMap[positions[i].inst])
+        ->setOperand(positions[i].operand,
+                     sharedFunc->getArg(representative->arg_size() +
+                                        paramOf[i]));
+  // The clone copies the visibility of the representative too
+  sharedFunc->setLinkage(Function::InternalLinkage);
+  sharedFunc->addFnAttr(Attribute::NoInline);
+
+  std::vector<std::vector<Value *>> constants(shape.members.size());
+  for (auto &column : columns)
+    for (size_t i = 0; i < column.size(); i++)
+      constants[i].push_back(column[i]);
+
+  for (size_t i = 0; i < shape.members.size(); i++) {
+    auto func = shape.members[i].func;
+    func->deleteBody();
+
+    std::vector<Value *> args;
+    for (auto &arg : func->args())
+      args.push_back(&arg);
+    args.insert(args.end(), constants[i].begin(), constants[i].end());
+
+    IRBuilder<> builder(BasicBlock::Create(func->getContext(), "", func));
+    auto call = builder.CreateCall(sharedFunc, args);
+    call->setTailCall();
+    if (func->getReturnType()->isVoidTy())
+      builder.CreateRetVoid();
+    else
+      builder.CreateRet(call);
+  }
+
+  for (size_t i = 0; i < shape.members.size(); i++)
+    bypass(shape.members[i].func, sharedFunc, constants[i]);
+
+  return true;
+}
+
+// Direct calls to a thunk call the shared body with its constants instead
+void ShapeSharing::bypass(Function *thunk, Function *sharedFunc,
+                          std::vector<Value *> &constants) {
+  std::vector<CallInst *> calls;
+  for (auto user : thunk->users())
+    if (auto call = dyn_cast<CallInst>(user))
+      if (call->getCalledFunction() == thunk &&
+          call->getFunction() != thunk)
+        calls.push_back(call);
+
+  for (auto call : calls) {
+    std::vector<Value *> args(call->arg_begin(), call->arg_end());
+    args.insert(args.end(), constants.begin(), constants.end());
+    auto direct = CallInst::Create(sharedFunc, args, "", call);
+    direct->takeName(call);
+    call->replaceAllUsesWith(direct);
+    call->eraseFromParent();
+  }
+}
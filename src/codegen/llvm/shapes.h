@@ -0,0 +1,61 @@
+#ifndef _shapes
+#define _shapes
+
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Transforms/Utils/FunctionComparator.h>
+#include <map>
+#include <utility>
+#include <vector>
+
+/*
+  Merges template instances whose code is the same up to integer constants,
+  as Scanner<512> and Scanner<65536> are up to the buffer size and the
+  offsets of the fields after it. The shared body takes those constants as
+  hidden parameters and each instance becomes a thunk passing its own, which
+  the inliner folds into the callers.
+*/
+class ShapeSharing {
+public:
+  ShapeSharing(const llvm::DataLayout &layout) : layout(layout) {}
+
+  void add(llvm::Function *func);
+  // Returns how many instances became thunks of a shared body
+  int run();
+
+private:
+  struct Position {
+    llvm::Instruction *inst;
+    unsigned operand;
+    bool operator<(const Position &other) const {
+      return inst != other.inst ? inst < other.inst : operand < other.operand;
+    }
+  };
+
+  struct Member {
+    llvm::Function *func;
+    // Constants of this member that differ from the representative
+    std::map<Position, llvm::ConstantInt *> constants;
+  };
+
+  struct Shape {
+    llvm::Function *representative;
+    std::vector<Member> members;
+  };
+
+  const llvm::DataLayout &layout;
+  std::vector<llvm::Function *> candidates;
+  llvm::GlobalNumberState globalNumbers;
+
+  void flattenAddresses(llvm::Function *func);
+  bool sameShape(llvm::Function *left, llvm::Function *right,
+                 Member &member);
+  bool share(Shape &shape);
+  void bypass(llvm::Function *thunk, llvm::Function *sharedFunc,
+              std::vector<llvm::Value *> &constants);
+
+  static bool isHiddenOperand(llvm::Instruction *inst, unsigned operand);
+};
+
+#endif
@@ -10,7 +10,7 @@ void Gu2CVisitor::visitFunction(FunctionNode *node) {
 
   std::string funcName = "func" + std::to_string(funcCounter++);
   if (node->_name == MAIN_FUNC)
-    funcName = node->_name;
+    funcName = node->_name.str();
 
   writeText(" " + funcName + "(");
 
@@ -30,17 +30,19 @@ void Gu2CVisitor::visitFunction(FunctionNode *node) {
 };
 
 void Gu2CVisitor::visitStructDef(StructDefNode *node) {
-  writeText("struct " + node->_name + " {");
-  for (auto &[_, member] : node->membersDef) {
+  writeText("struct " + node->_name.str() + " {");
+  for (auto member : node->_members) {
+    if (member->getNodeType() != NodeType::VAR_DEF)
+      continue;
     writeText("\n\t");
     member->visit(this);
     writeText(";");
   }
   writeText("\n}\n\n");
 
-  for (auto &[_, func] : node->funcMembers)
-    if (func)
-        func->visit(this);
+  for (auto member : node->_members)
+    if (member->getNodeType() == NodeType::FUNCTION)
+      member->visit(this);
 };
 
 void Gu2CVisitor::visitBody(BodyNode *node) {
@@ -97,7 +99,7 @@ void Gu2CVisitor::visitFor(ForNode *node) {
 
 void Gu2CVisitor::visitVarDef(VarDefNode *node) {
   node->_typeDef->visit(this);
-  writeText(" " + node->_name);
+  writeText(" " + node->_name.str());
   if (node->_defaultVal) {
     writeText(" = ");
     node->_defaultVal->visit(this);
@@ -114,7 +116,7 @@ void Gu2CVisitor::visitTypeDefNode(TypeDefNode *node) {
   } else {
     if (node->dataType->raw == RawDataType::STRUCT)
       writeText("struct ");
-    writeText(node->_rawIdent);
+    writeText(node->_rawIdent.str());
   }
 };
 
@@ -134,7 +136,7 @@ void Gu2CVisitor::visitExprBinaryOp(ExprBinaryNode *node) {
   writeText("(");
   node->_left->visit(this);
   writeText(")");
-  writeText(node->_op);
+  writeText(operatorName(node->_op));
   writeText("(");
   node->_right->visit(this);
   writeText(")");
@@ -143,7 +145,7 @@ void Gu2CVisitor::visitExprBinaryOp(ExprBinaryNode *node) {
 void Gu2CVisitor::visitMemberAccess(ExprMemberAccess *node) {
   node->_struct->visit(this);
   writeText(".");
-  writeText(node->_memberName);
+  writeText(node->_memberName.str());
 };
 
 void Gu2CVisitor::visitIndexAccess(ExprIndex *node) {
@@ -154,7 +156,7 @@ void Gu2CVisitor::visitIndexAccess(ExprIndex *node) {
 };
 
 void Gu2CVisitor::visitExprCall(ExprCallNode *node) {
-  writeText(node->func->_name);
+  writeText(node->func->_name.str());
   writeText("(");
   if (!node->_args.empty()) {
     node->_args[0]->visit(this);
@@ -167,14 +169,14 @@ void Gu2CVisitor::visitExprCall(ExprCallNode *node) {
 };
 
 void Gu2CVisitor::visitExprUnaryOp(ExprUnaryNode *node) {
-  writeText(node->_op);
+  writeText(operatorName(node->_op));
   writeText("(");
   node->_expr->visit(this);
   writeText(")");
 };
 
 void Gu2CVisitor::visitExprVarRef(ExprVarRefNode *node) {
-  writeText(node->_ident);
+  writeText(node->_ident.str());
 };
 
 void Gu2CVisitor::visitExprConstant(ExprConstantNode *node) {
@@ -1,20 +1,56 @@
 #include "lexer.h"
+#include <algorithm>
 #include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <fcntl.h>
 #include <filesystem>
 #include <iostream>
+#include <iterator>
 #include <string>
-#include <unordered_set>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
-// These characters are single-chars token
-const std::unordered_set<std::string> reservedWords = {
-    "_LEXER__CHAR__", "_LEXER__STRING__", "_LEXER__NUMBER__",
-    "_LEXER__IDENTIFIER__"};
-
 Lexer::Lexer() {}
 
-Lexer::~Lexer() { delete this->stream; }
+static std::string unescape(std::string_view literal) {
+  std::string s = "";
+  for (size_t i = 0; i < literal.size(); i++) {
+    char c = literal[i];
+    if (c == '\\') {
+      c = literal[++i];
+      switch (c) {
+      case 'n':
+        c = '\n';
+        break;
+      case 'b':
+        c = '\b';
+        break;
+      case 't':
+        c = '\t';
+        break;
+      case 'r':
+        c = '\r';
+        break;
+      case '0':
+        c = '\0';
+        break;
+      default:;
+      }
+    }
+
+    s += c;
+  }
+  return s;
+}
+
+Lexer::~Lexer() {
+  if (mapped)
+    munmap((void *)source, sourceSize);
+}
 
 Lexer *Lexer::fromFile(std::string path) {
   if (!fs::exists(path)) {
@@ -22,56 +58,108 @@ Lexer *Lexer::fromFile(std::string path) {
     exit(1);
   }
 
-  auto fileStream = new std::ifstream(path);
-  if (!fileStream) {
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat fileStat;
+  if (fd < 0 || fstat(fd, &fileStat) < 0) {
     std::cerr << "Was not possible to open the file\n";
     exit(1);
   }
 
+  if (fileStat.st_size == 0) {
+    close(fd);
+    return fromStream(new std::ifstream(path), fs::canonical(path));
+  }
+
+  void *mapping =
+      mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (mapping == MAP_FAILED)
+    return fromStream(new std::ifstream(path), fs::canonical(path));
+
+  madvise(mapping, fileStat.st_size, MADV_SEQUENTIAL);
+
   auto sc = new Lexer;
-  sc->stream = fileStream;
+  sc->source = (const char *)mapping;
+  sc->sourceSize = fileStat.st_size;
+  sc->mapped = true;
   sc->filename = fs::canonical(path);
+  sc->fileId = FileTable::global().add(sc->filename);
   return sc;
 }
 
 Lexer *Lexer::fromStream(std::istream *stream, std::string filename) {
-  auto sc = new Lexer;
-  sc->stream = stream;
-  if (!sc->stream) {
+  if (!stream || !*stream) {
     std::cerr << "Was not possible to open the file\n";
     exit(1);
   }
+
+  auto sc = new Lexer;
+  sc->streamBuff.assign(std::istreambuf_iterator<char>(*stream),
+                        std::istreambuf_iterator<char>());
+  delete stream;
+
+  sc->source = sc->streamBuff.data();
+  sc->sourceSize = sc->streamBuff.size();
   sc->filename = filename;
+  sc->fileId = FileTable::global().add(filename);
   return sc;
 }
 
-void Lexer::setTypeMapper(std::map<std::string, int> *tokenMapper) {
+void Lexer::setTypeMapper(const TokenTable *tokenMapper) {
   this->tokenMapper = tokenMapper;
+
+  // The mapper reserves these words to name the lexer token classes
+  identifierType = mapToken("_LEXER__IDENTIFIER__");
+  numberType = mapToken("_LEXER__NUMBER__");
+  stringType = mapToken("_LEXER__STRING__");
+  charType = mapToken("_LEXER__CHAR__");
+}
+
+inline char Lexer::lookChar() { return pos < sourceSize ? source[pos] : '\0'; }
+
+inline char Lexer::getChar() {
+  char c = lookChar();
+  if (pos < sourceSize)
+    pos++;
+  return column++, c;
 }
 
-const Token &Lexer::look() { return current; }
+const Token &Lexer::look() { return ring[head]; }
 std::string &Lexer::getFileName() { return filename; }
 
-void Lexer::unget() {
-  if (ungetted) {
-    std::cerr << "Ungetted two tokens\n";
+const Token &Lexer::get() {
+  head = (head + 1) % LOOKAHEAD_SIZE;
+  if (buffered)
+    buffered--;
+  else
+    nextToken(ring[head]);
+
+  return ring[head];
+}
+
+const Token &Lexer::peek(int n) {
+  if (n >= LOOKAHEAD_SIZE - 1) {
+    std::cerr << "Lookahead of " << n << " tokens is too far\n";
     exit(1);
   }
-  ungetted = true;
-}
 
-const Token &Lexer::get() {
-  if (ungetted) {
-    ungetted = false;
-    return current;
+  while (buffered <= n) {
+    buffered++;
+    nextToken(ring[(head + buffered) % LOOKAHEAD_SIZE]);
   }
+  return ring[(head + n + 1) % LOOKAHEAD_SIZE];
+}
 
+void Lexer::nextToken(Token &token) {
+  current = &token;
+  current->symbol = Symbol();
   passBlanks();
 
   char nextChar = lookChar();
 
-  current.line = line;
-  current.start = column;
+  current->line = line;
+  current->start = column;
 
   if (std::isalpha(nextChar) || nextChar == '_')
     nextToken_Indentifier();
@@ -84,71 +172,56 @@ const Token &Lexer::get() {
   else if (std::ispunct(nextChar))
     nextToken_General();
   else {
-    current.raw = "";
-    current.mappedType = 0;
-    current.rawType = TokenType::END_OF_INPUT;
+    current->raw = {};
+    current->mappedType = 0;
+    current->rawType = TokenType::END_OF_INPUT;
   }
 
-  current.end = column;
-
-  return current;
+  current->end = column;
 }
 
 void Lexer::nextToken_Indentifier() {
-  std::string s = "";
+  size_t start = pos;
   while (isalnum((lookChar())) || lookChar() == '_')
-    s += getChar();
+    getChar();
+
+  std::string_view s(source + start, pos - start);
+  int mapped = mapToken(s);
 
-  if (reservedWords.find(s) != reservedWords.end())
-    error("Use of lexer reserved word: " + s);
+  if (mapped && (mapped == identifierType || mapped == numberType ||
+                 mapped == stringType || mapped == charType))
+    error("Use of lexer reserved word: " + std::string(s));
 
-  current.raw = s;
-  current.mappedType =
-      tokenMapper ? (*tokenMapper)[s] ? (*tokenMapper)[s]
-                                      : (*tokenMapper)["_LEXER__IDENTIFIER__"]
-                  : 0;
-  current.rawType = TokenType::NAME;
+  current->raw = s;
+  current->symbol = mapped ? Symbol() : Symbol(s);
+  current->mappedType = mapped ? mapped : identifierType;
+  current->rawType = TokenType::NAME;
 }
 
 void Lexer::nextToken_String() {
   getChar();
-  std::string s = "";
+  size_t start = pos;
+  bool escaped = false;
   while (lookChar() && lookChar() != '"') {
-    char c = getChar();
-    if (c == '\\') {
-      c = getChar();
-      switch (c) {
-      case 'n':
-        c = '\n';
-        break;
-      case 'b':
-        c = '\b';
-        break;
-      case 't':
-        c = '\t';
-        break;
-      case 'r':
-        c = '\r';
-        break;
-      case '0':
-        c = '\0';
-        break;
-      default:;
-      }
+    if (getChar() == '\\') {
+      escaped = true;
+      getChar();
     }
-
-    s += c;
   }
   if (!lookChar())
     error("Unexpected EOF reading string");
+
+  std::string_view literal(source + start, pos - start);
   getChar();
 
-  current.raw = s;
-  current.rawType = TokenType::STRING;
-  current.mappedType = tokenMapper ? (*tokenMapper)["_LEXER__STRING__"] : 0;
+  // Only escaped literals need an owned copy, the rest points to the source
+  current->raw = escaped ? ownLiteral(unescape(literal)) : literal;
+  current->rawType = TokenType::STRING;
+  current->mappedType = stringType;
 }
 
 void Lexer::nextToken_Char() {
+  size_t start = pos;
   getChar();
 
   int c = lookChar();
@@ -179,90 +252,70 @@ void Lexer::nextToken_Char() {
   if (getChar() != '\'')
     error("Expecting ' got " + std::to_string(lookChar()) + " reading char");
 
-  current.raw = std::to_string(c);
-  current.rawType = TokenType::CHAR;
-  current.mappedType = tokenMapper ? (*tokenMapper)["_LEXER__CHAR__"] : 0;
+  current->raw = std::string_view(source + start, pos - start);
+  current->intValue = c;
+  current->isFloat = false;
+  current->rawType = TokenType::CHAR;
+  current->mappedType = charType;
 }
 
 void Lexer::nextToken_Number() {
-  std::string s = "";
-  s += getChar();
-  if (s == "0" && lookChar() == 'x') {
+  size_t start = pos;
+  int base = 10;
+  if (lookChar() == '0' && pos + 1 < sourceSize &&
+      (source[pos + 1] == 'x' || source[pos + 1] == 'b')) {
     getChar();
-    s = "";
-    while (std::isxdigit(lookChar()))
-      s += getChar();
-
-    char *end = nullptr;
-    int shex = std::strtol(s.c_str(), &end, 16);
-    if (end == s.c_str() || *end != '\0' || errno == ERANGE) {
-      error("Invalid hex value");
-    }
+    base = getChar() == 'x' ? 16 : 2;
+  }
 
-    s = std::to_string(shex);
-  } else if (s == "0" && lookChar() == 'b') {
+  size_t digitsStart = pos;
+  while (base == 16 ? std::isxdigit(lookChar()) : std::isdigit(lookChar()))
     getChar();
-    int val = 0;
-    while (std::isdigit(lookChar())) {
-      char c = getChar();
-      if (c != '0' && c != '1')
-        error("Invalid binary value");
 
-      val = c == '0' ? 2 * val : 2 * val + 1;
-    }
-    s = std::to_string(val);
-  } else {
+  current->isFloat = base == 10 && lookChar() == '.';
+  if (current->isFloat) {
+    getChar();
     while (std::isdigit(lookChar()))
-      s += getChar();
-    if (lookChar() == '.') {
       getChar();
-      while (std::isdigit(lookChar()))
-        s += getChar();
-    }
   }
 
-  current.raw = s;
-  current.rawType = TokenType::NUMBER;
-  current.mappedType = tokenMapper ? (*tokenMapper)["_LEXER__NUMBER__"] : 0;
+  current->raw = std::string_view(source + start, pos - start);
+  current->rawType = TokenType::NUMBER;
+  current->mappedType = numberType;
+
+  if (current->isFloat) {
+    current->floatValue = std::strtod(std::string(current->raw).c_str(), 0);
+    return;
+  }
+
+  const char *first = source + digitsStart;
+  const char *last = source + pos;
+  auto [end, ec] = std::from_chars(first, last, current->intValue, base);
+  if (ec == std::errc::result_out_of_range)
+    error("Number out of range");
+  if (first == last || end != last)
+    error(base == 16 ? "Invalid hex value" : "Invalid binary value");
 }
 
 void Lexer::nextToken_General() {
-  std::string s = "";
-  s += getChar();
+  size_t start = pos;
+  getChar();
   while (std::ispunct(lookChar()) &&
-         tokenMapper->find(s + lookChar()) != tokenMapper->end())
-    s += getChar();
-
-  current.raw = s;
-  current.mappedType = tokenMapper ? (*tokenMapper)[s] : 0;
-  current.rawType = TokenType::GENERAL;
-}
+         mapToken(std::string_view(source + start, pos - start + 1)))
+    getChar();
 
-char Lexer::getChar() {
-  char c = lookChar();
-  buff.pop();
-  return column++, c;
+  current->raw = std::string_view(source + start, pos - start);
+  current->mappedType = mapToken(current->raw);
+  current->rawType = TokenType::GENERAL;
 }
 
-char Lexer::lookChar() {
-  if (buff.empty() && !reloadBuffer())
-    return '\0';
-  char c = buff.front();
-  return c;
+int Lexer::mapToken(std::string_view raw) {
+  return tokenMapper ? tokenMapper->find(raw) : 0;
 }
 
-bool Lexer::reloadBuffer() {
-  char buff[READ_BUFF_SIZE];
-
-  stream->read(buff, READ_BUFF_SIZE);
-  ssize_t readen = stream->gcount();
-  if (!readen)
-    return false;
-
-  for (int i = 0; i < readen; i++)
-    this->buff.push(buff[i]);
-
-  return true;
+std::string_view Lexer::ownLiteral(std::string literal) {
+  ownedLiterals.push_back(std::move(literal));
+  return ownedLiterals.back();
 }
 
 void inline Lexer::error(std::string msg) {
@@ -274,10 +327,49 @@ void inline Lexer::error(std::string msg) {
 }
 
 void inline Lexer::passBlanks() {
-  while (std::isspace(lookChar())) {
-    if (getChar() == '\n') {
-      line++;
-      column = 1;
+  while (true) {
+    char c = lookChar();
+    if (std::isspace(c)) {
+      if (getChar() == '\n') {
+        line++;
+        column = 1;
+      }
+      continue;
     }
+
+    if (c != '/' || pos + 1 >= sourceSize)
+      return;
+
+    std::string_view rest(source + pos, sourceSize - pos);
+    if (source[pos + 1] == '*') {
+      size_t end = rest.find("*/", 2);
+      if (end == std::string_view::npos) {
+        skipTo(sourceSize);
+        error("Unclosed comment");
+      }
+      skipTo(pos + end + 2);
+    } else if (source[pos + 1] == '/') {
+      size_t end = rest.find('\n', 2);
+      skipTo(end == std::string_view::npos ? sourceSize : pos + end);
+    } else
+      return;
   }
+}
+
+// Jumps over a comment keeping the line and column in sync
+void Lexer::skipTo(size_t end) {
+  const char *from = source + pos;
+  const char *to = source + end;
+
+  auto breaks = std::count(from, to, '\n');
+  if (breaks) {
+    const char *lastBreak = to;
+    while (*--lastBreak != '\n')
+      ;
+    line += breaks;
+    column = to - lastBreak;
+  } else
+    column += end - pos;
+
+  pos = end;
 }
\ No newline at end of file
@@ -1,15 +1,15 @@
 #ifndef _lexer
 #define _lexer
+#include "../ast/location.h"
+#include "../ast/symbols.h"
 #include <cctype>
+#include <cstdint>
+#include <deque>
 #include <fstream>
 #include <istream>
-#include <queue>
 #include <stdexcept>
 #include <string>
-#include <map>
-#include <unordered_set>
-
-const int READ_BUFF_SIZE = 2048;
+#include <string_view>
 
 enum class TokenType {
   NAME,
@@ -20,58 +20,154 @@ enum class TokenType {
   END_OF_INPUT,
 };
 
+/*
+  raw points into the lexer source, or into the lexer literal pool for
+  escaped strings, so it is only valid while the lexer is alive.
+  Identifiers also carry their interned symbol, numbers and chars their
+  decoded value.
+*/
 struct Token {
-  std::string raw;
+  std::string_view raw;
+  Symbol symbol;
   int mappedType;
   TokenType rawType;
 
+  union {
+    uint64_t intValue;
+    double floatValue;
+  };
+  bool isFloat;
+
   int line;
   int start;
   int end;
 };
 
+struct TokenEntry {
+  std::string_view raw;
+  int mappedType;
+};
+
+const int TOKEN_TABLE_BITS = 8;
+const int LOOKAHEAD_SIZE = 4;
+const size_t TOKEN_TABLE_SIZE = 1 << TOKEN_TABLE_BITS;
+
+/*
+  Perfect hash table built at compile time, the seed is searched until every
+  entry owns a slot, so a lookup is one hash and one compare and the table is
+  never mutated
+*/
+class TokenTable {
+public:
+  template <size_t N> constexpr TokenTable(const TokenEntry (&entries)[N]) {
+    for (auto &entry : entries)
+      if (entry.raw.size() > maxLength)
+        maxLength = entry.raw.size();
+
+    for (seed = 1; seed < 0xFFFF; seed++) {
+      perfect = true;
+      for (auto &slot : slots)
+        slot = TokenEntry{};
+
+      for (auto &entry : entries) {
+        auto &slot = slots[slotOf(entry.raw, seed)];
+        if (!slot.raw.empty()) {
+          perfect = false;
+          break;
+        }
+        slot = entry;
+      }
+
+      if (perfect)
+        return;
+    }
+  }
+
+  int find(std::string_view raw) const {
+    if (raw.empty() || raw.size() > maxLength)
+      return 0;
+    auto &slot = slots[slotOf(raw, seed)];
+    return slot.raw == raw ? slot.mappedType : 0;
+  }
+
+  constexpr bool isPerfect() const { return perfect; }
+
+private:
+  TokenEntry slots[TOKEN_TABLE_SIZE] = {};
+  unsigned seed = 0;
+  size_t maxLength = 0;
+  bool perfect = false;
+
+  static constexpr unsigned slotOf(std::string_view raw, unsigned seed) {
+    unsigned hash = 2166136261u;
+    for (char c : raw)
+      hash = (hash ^ (unsigned char)c) * 16777619u;
+    return (hash * (2 * seed + 1)) >> (32 - TOKEN_TABLE_BITS);
+  }
+};
+
 class Lexer {
 public:
   ~Lexer();
 
   static Lexer *fromFile(std::string path);
   static Lexer *fromStream(std::istream *stream, std::string filename);
-  void setTypeMapper(std::map<std::string, int> *tokenMapper);
+  void setTypeMapper(const TokenTable *tokenMapper);
 
+  // look is the last token returned by get, peek(n) the n-th one after it
   const Token &look();
   const Token &get();
-  void unget();
+  const Token &peek(int n = 0);
 
   std::string &getFileName();
+  FileId getFileId() { return fileId; }
 
 private:
   Lexer();
 
-  std::map<std::string, int> *tokenMapper;
-  std::queue<char> buff;
-  std::istream *stream;
-
-  Token current;
-  bool ungetted = false;
+  const TokenTable *tokenMapper = nullptr;
+  int identifierType = 0;
+  int numberType = 0;
+  int stringType = 0;
+  int charType = 0;
+
+  // The whole source is kept contiguous, mmaped from the file or copied from
+  // the stream, so tokens can be handed out as views over it
+  const char *source = nullptr;
+  size_t sourceSize = 0;
+  size_t pos = 0;
+  bool mapped = false;
+  std::string streamBuff;
+  std::deque<std::string> ownedLiterals;
+
+  // Tokens are lexed in place into the ring, head is the last one consumed
+  // and the next ones are the buffered lookahead
+  Token ring[LOOKAHEAD_SIZE] = {};
+  int head = 0;
+  int buffered = 0;
+  Token *current = ring;
 
   int line = 1;
   int column = 1;
   std::string filename;
+  FileId fileId = 0;
 
-  void nextToken();
+  void nextToken(Token &token);
   void nextToken_Indentifier();
   void nextToken_Number();
   void nextToken_Char();
   void nextToken_String();
   void nextToken_General();
 
-  char getChar();
-  char lookChar();
+  inline char getChar();
+  inline char lookChar();
 
-  bool reloadBuffer();
+  int mapToken(std::string_view raw);
+  std::string_view ownLiteral(std::string literal);
 
   inline void passBlanks();
+  void skipTo(size_t end);
   inline void error(std::string msg);
 };
 
-#endif
\ No newline at end of file
+#endif
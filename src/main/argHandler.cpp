@@ -39,6 +39,23 @@ void ArgHandler::parseError(std::string msg) {
   std::cerr << "\t[--opt -O] level -> Specify the optimization level to use "
                "(0, 1, 2, 3). "
                "The default value is 2\n";
+  std::cerr << "\t[--shared-generics -G] -> Template instances differing only "
+               "in sizes and offsets share one body, except hot functions\n";
+  std::cerr << "\t[--interface -i] -> Precompiles the declaration file into "
+               "a .gpi interface, loaded by imports instead of parsing it\n";
+  std::cerr << "\t[--modules -M] -> Compiles each .gu imported by path to "
+               "its own cached object, rebuilt only when it or its imports "
+               "change\n";
+  std::cerr << "\t[--cache -C] -> Reuses the output of a previous compilation "
+               "with the same sources, imports and flags\n";
+  std::cerr << "\t[--cache-stats] -> Prints the hits and misses of the "
+               "compilation cache\n";
+  std::cerr << "\t[--jobs -j] count -> Compiles each .gu file given on its "
+               "own with count parallel jobs, the other files are objects "
+               "linked into each one. Outputs go next to the sources, or -o "
+               "names a directory for them, created when missing\n";
+  std::cerr << "\t[--time] -> Prints the time the compilation spent in "
+               "each phase\n";
   exit(1);
 }
 
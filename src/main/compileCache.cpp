@@ -0,0 +1,196 @@
+#include "compileCache.h"
+#include "../parser/processors/moduleCache.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <llvm-c/Core.h>
+#include <llvm-c/TargetMachine.h>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace fs = std::filesystem;
+
+const char *GU_CACHE_SIZE_ENV_VAR = "GU_CACHE_SIZE";
+const uintmax_t DEFAULT_CACHE_SIZE = 512;
+// Sets of inputs remembered per manifest, newest first
+const size_t MANIFEST_ENTRIES = 8;
+
+static fs::path outputsDir() { return ModuleCache::cacheDir() / "outputs"; }
+
+static uintmax_t sizeLimit() {
+  auto size = std::getenv(GU_CACHE_SIZE_ENV_VAR);
+  uintmax_t megabytes = size ? std::strtoull(size, nullptr, 10) : 0;
+  return (megabytes ? megabytes : DEFAULT_CACHE_SIZE) << 20;
+}
+
+// Written aside and renamed, concurrent builds never read half a file
+static void replaceFile(fs::path path, std::string content) {
+  auto tmpPath = path.string() + ModuleCache::tmpSuffix();
+  std::ofstream stream(tmpPath, std::ios::binary);
+  stream << content;
+  stream.close();
+
+  std::error_code ec;
+  if (!stream || (fs::rename(tmpPath, path, ec), ec))
+    fs::remove(tmpPath, ec);
+}
+
+CompileCache::CompileCache(std::string entry, std::string flags) {
+  dir = outputsDir();
+
+  auto triple = LLVMGetDefaultTargetTriple();
+  auto libPath = std::getenv("GU_LIB_PATH");
+  std::error_code ec;
+  // Imports by path are relative to the working directory
+  key = ModuleCache::hashString(flags + "\t" + triple + "\t" +
+                                fs::current_path(ec).string() + "\t" +
+                                fs::absolute(entry, ec).string() + "\t" +
+                                (libPath ? libPath : ""));
+  key = ModuleCache::combine(key, ModuleCache::compilerId());
+  LLVMDisposeMessage(triple);
+}
+
+fs::path CompileCache::manifestPath() {
+  return dir / (ModuleCache::toHex(key) + ".manifest");
+}
+
+/*
+  The manifest has a block of lines per set of inputs, each line a path and
+  the hash of its content, the blocks separated by an empty line. Going
+  back to an earlier version of a file still finds its output.
+*/
+bool CompileCache::restore(std::string out) {
+  std::ifstream manifest(manifestPath());
+  std::map<std::string, uint64_t> hashes;
+  bool found = false;
+
+  std::string line;
+  while (!found && manifest.is_open() && !manifest.eof()) {
+    uint64_t outputKey = key;
+    bool matches = true;
+    while (std::getline(manifest, line) && !line.empty()) {
+      auto tab = line.rfind('\t');
+      auto path = line.substr(0, tab);
+      auto hash = std::strtoull(line.c_str() + tab + 1, nullptr, 16);
+      if (!hashes.count(path))
+        hashes[path] = ModuleCache::hashFile(path);
+      matches = matches && tab != std::string::npos && hashes[path] == hash;
+      outputKey = ModuleCache::combine(outputKey, hash);
+    }
+    if (!matches)
+      continue;
+
+    std::error_code ec;
+    auto output = dir / (ModuleCache::toHex(outputKey) + ".out");
+    found = fs::copy_file(output, out, fs::copy_options::overwrite_existing,
+                          ec);
+    // Evicted last among the outputs
+    if (found)
+      fs::last_write_time(output, fs::file_time_type::clock::now(), ec);
+  }
+
+  count(found);
+  return found;
+}
+
+void CompileCache::store(std::string out,
+                         const std::vector<std::string> &inputs) {
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+
+  std::string entry;
+  uint64_t outputKey = key;
+  for (auto &input : inputs) {
+    auto hash = ModuleCache::hashFile(input);
+    entry += input + "\t" + ModuleCache::toHex(hash) + "\n";
+    outputKey = ModuleCache::combine(outputKey, hash);
+  }
+
+  std::string manifest = entry;
+  std::ifstream previous(manifestPath());
+  std::string line, block;
+  for (size_t entries = 1; std::getline(previous, line);) {
+    if (!line.empty()) {
+      block += line + "\n";
+      continue;
+    }
+    if (block != entry && entries++ < MANIFEST_ENTRIES)
+      manifest += "\n" + block;
+    block.clear();
+  }
+  manifest += "\n";
+
+  auto output = dir / (ModuleCache::toHex(outputKey) + ".out");
+  auto tmpPath = output.string() + ModuleCache::tmpSuffix();
+  fs::copy_file(out, tmpPath, fs::copy_options::overwrite_existing, ec);
+  if (ec || (fs::rename(tmpPath, output, ec), ec)) {
+    fs::remove(tmpPath, ec);
+    return;
+  }
+  replaceFile(manifestPath(), manifest);
+
+  evict();
+}
+
+void CompileCache::evict() {
+  std::vector<std::tuple<fs::file_time_type, uintmax_t, fs::path>> outputs;
+  uintmax_t total = 0;
+  std::error_code ec;
+  for (auto &file : fs::directory_iterator(dir, ec)) {
+    if (file.path().extension() != ".out")
+      continue;
+    auto size = file.file_size(ec);
+    outputs.push_back({file.last_write_time(ec), size, file.path()});
+    total += size;
+  }
+
+  auto limit = sizeLimit();
+  if (total <= limit)
+    return;
+
+  // Down to 90% so the next stores do not scan the directory again
+  std::sort(outputs.begin(), outputs.end());
+  for (auto &[_, size, path] : outputs) {
+    if (total <= limit / 10 * 9)
+      break;
+    if (fs::remove(path, ec))
+      total -= size;
+  }
+}
+
+void CompileCache::count(bool hit) {
+  // The jobs of a batch would lose each other's counts
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto path = outputsDir() / "stats";
+  unsigned long long hits = 0, misses = 0;
+  std::ifstream(path) >> hits >> misses;
+  (hit ? hits : misses)++;
+
+  std::error_code ec;
+  fs::create_directories(outputsDir(), ec);
+  replaceFile(path,
+              std::to_string(hits) + " " + std::to_string(misses) + "\n");
+}
+
+void CompileCache::printStats() {
+  unsigned long long hits = 0, misses = 0;
+  std::ifstream(outputsDir() / "stats") >> hits >> misses;
+
+  uintmax_t total = 0, entries = 0;
+  std::error_code ec;
+  for (auto &file : fs::directory_iterator(outputsDir(), ec)) {
+    if (file.path().extension() != ".out")
+      continue;
+    total += file.file_size(ec);
+    entries++;
+  }
+
+  std::cout << "cache directory: " << outputsDir().string() << "\n";
+  std::cout << "hits: " << hits << "\n";
+  std::cout << "misses: " << misses << "\n";
+  std::cout << "outputs: " << entries << ", " << (total >> 10) << " KB of "
+            << (sizeLimit() >> 20) << " MB\n";
+}
@@ -0,0 +1,36 @@
+#ifndef _compileCache
+#define _compileCache
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/*
+  Outputs of whole compilations, kept in GU_CACHE_DIR/outputs for builds
+  repeating the same inputs. A manifest found by the entry file, the flags,
+  the target and the compiler lists every file the compilation read with
+  its hash, and the output is stored under the hash of all of them, so a
+  hit is known before parsing anything. Once the outputs take more than
+  GU_CACHE_SIZE megabytes (512 by default) the least used ones are evicted.
+*/
+class CompileCache {
+public:
+  CompileCache(std::string entry, std::string flags);
+
+  // Writes the cached output to out when none of the inputs changed
+  bool restore(std::string out);
+  void store(std::string out, const std::vector<std::string> &inputs);
+
+  static void printStats();
+
+private:
+  std::filesystem::path dir;
+  uint64_t key;
+
+  std::filesystem::path manifestPath();
+  static void count(bool hit);
+  void evict();
+};
+
+#endif
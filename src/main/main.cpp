@@ -2,14 +2,30 @@
 #include "../lexer/lexer.h"
 #include "../parser/parser.h"
 #include "../parser/processors/importManager.h"
+#include "../parser/processors/interface.h"
+#include "../parser/processors/moduleCache.h"
+#include "../parser/processors/reachability.h"
 #include "../parser/processors/templates.h"
+#include "../semantic/constFolder.h"
 #include "../semantic/validator.h"
 #include "argHandler.h"
+#include "compileCache.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <cstdlib>
+#include <sstream>
 #include <string>
+#include <thread>
 
-ProgramNode *getProgramAst(std::string filename, std::vector<std::string> &filenames) {
-  ImportManager importManager;
+namespace fs = std::filesystem;
+
+ProgramNode *getProgramAst(std::string filename,
+                           std::vector<std::string> &filenames,
+                           ModuleCache *modules = nullptr,
+                           std::vector<std::string> *sources = nullptr) {
+  ImportManager importManager(modules);
   AstCloner astCloner;
   TemplatesVisitor genericVisitor(&astCloner);
 
@@ -22,6 +38,9 @@ ProgramNode *getProgramAst(std::string filename, std::vector<std::string> &filen
 
   for (auto file: importManager.getImportedFiles())
     filenames.push_back(file);
+  if (sources)
+    for (auto &file : importManager.getSourceFiles())
+      sources->push_back(file);
 
   return program;
 }
@@ -54,6 +73,31 @@ void runValidator(ProgramNode *programAst, SemanticValidator *validator) {
   }
 }
 
+void runFolder(ProgramNode *programAst, ConstFolder *folder) {
+  folder->visitProgram(programAst);
+  auto errors = folder->getErrors();
+  if (errors.size()) {
+    std::cerr << "There are errors in the source code:\n\n";
+    for (auto err : errors)
+      std::cerr << err << '\n';
+    exit(1);
+  }
+}
+
+// Validated as any import of it would be, written as it was parsed
+void buildInterface(std::string filename, std::string out) {
+  std::vector<std::string> filenames;
+  SemanticValidator validator(false);
+  runValidator(getProgramAst(filename, filenames), &validator);
+
+  AstParser parser(Lexer::fromFile(filename));
+  std::string error;
+  if (!ModuleInterface::write(parser.parseProgram(), filename, out, error)) {
+    std::cerr << "interface error: " << error << "\n";
+    exit(1);
+  }
+}
+
 void runAssembler(ProgramNode *programAst, Assembler *assembler) {
   assembler->visitProgram(programAst);
 }
@@ -74,12 +118,182 @@ void compile(Assembler *assembler, std::string out, char optLevel,
     assembler->printAssembled(out);
 }
 
+// Same for every file of a build
+struct CompileOptions {
+  std::string asmType;
+  char optLevel;
+  bool withEntrypoint;
+  bool sharedGenerics;
+  ModuleCache *modules;
+  bool cache;
+  std::string cacheFlags;
+};
+
+// Milliseconds a compilation spent in each phase
+struct PhaseTimes {
+  double frontend = 0;
+  double lowering = 0;
+  double backend = 0;
+  double linking = 0;
+};
+
+// Milliseconds since start, which moves to now
+double lap(std::chrono::steady_clock::time_point &start) {
+  auto now = std::chrono::steady_clock::now();
+  std::chrono::duration<double, std::milli> elapsed = now - start;
+  start = now;
+  return elapsed.count();
+}
+
+void compileFile(const CompileOptions &options, std::string filename,
+                 std::string outName, std::vector<std::string> objects,
+                 PhaseTimes &times) {
+  auto start = std::chrono::steady_clock::now();
+  bool toBinary = options.asmType == "exec";
+
+  std::unique_ptr<CompileCache> cache;
+  if (options.cache) {
+    cache = std::make_unique<CompileCache>(filename, options.cacheFlags);
+    if (cache->restore(outName)) {
+      times.frontend += lap(start);
+      return;
+    }
+  }
+
+  SemanticValidator validator(options.withEntrypoint);
+  ConstFolder folder;
+  Assembler assembler(options.withEntrypoint, options.sharedGenerics);
+
+  std::vector<std::string> inputs = {filename};
+  auto programAst = getProgramAst(filename, objects, options.modules, &inputs);
+  Reachability reachability(options.withEntrypoint);
+  reachability.visitProgram(programAst);
+  runValidator(programAst, &validator);
+  runFolder(programAst, &folder);
+  times.frontend += lap(start);
+
+  runAssembler(programAst, &assembler);
+  times.lowering += lap(start);
+
+  // Next to the output, parallel jobs never write the same object
+  std::string objName = outName + ".tmp.o";
+  compile(&assembler, toBinary ? objName : outName, options.optLevel,
+          options.asmType);
+  times.backend += lap(start);
+
+  if (toBinary) {
+    std::vector<std::string> ldArgs = {"ld", objName, "-o", outName};
+    ldArgs.insert(ldArgs.end(), objects.begin(), objects.end());
+    std::istringstream suffix(getLoaderSuffix());
+    for (std::string arg; suffix >> arg;)
+      ldArgs.push_back(arg);
+    bool linked = ModuleCache::spawn(ldArgs);
+    std::error_code ec;
+    fs::remove(objName, ec);
+    if (!linked) {
+      std::cerr << "There are errors during the linking phase\n";
+      exit(1);
+    }
+    // Objects given or imported are linked into the output
+    inputs.insert(inputs.end(), objects.begin(), objects.end());
+    times.linking += lap(start);
+  }
+
+  if (cache)
+    cache->store(outName, inputs);
+}
+
+// Next to the source or in the output directory, named after the source
+std::string batchOutput(std::string filename, std::string asmType,
+                        std::string outDir) {
+  fs::path out = filename;
+  if (!outDir.empty())
+    out = fs::path(outDir) / out.filename();
+
+  if (asmType == "exec")
+    return out.replace_extension().string();
+  if (asmType == "asm")
+    return out.replace_extension(".s").string();
+  if (asmType == "obj")
+    return out.replace_extension(".o").string();
+  return out.replace_extension(".ll").string();
+}
+
+// Phases are summed over the jobs, they overlap in the wall time
+void printTimes(std::vector<PhaseTimes> &times, unsigned jobs, double wall) {
+  PhaseTimes total;
+  for (auto &job : times) {
+    total.frontend += job.frontend;
+    total.lowering += job.lowering;
+    total.backend += job.backend;
+    total.linking += job.linking;
+  }
+  std::fprintf(stderr,
+               "compiled %zu files with %u jobs in %.1f ms\n"
+               "  frontend %.1f ms, lowering %.1f ms, optimization and "
+               "emission %.1f ms, linking %.1f ms\n",
+               times.size(), jobs, wall, total.frontend, total.lowering,
+               total.backend, total.linking);
+}
+
+/*
+  Compiles every .gu file given on its own, the other files are objects
+  linked into each executable. Jobs run on a pool of threads, each with its
+  own arena, LLVM context and assembler.
+*/
+void compileBatch(const CompileOptions &options,
+                  std::vector<std::string> &filenames, std::string outDir,
+                  unsigned jobs, bool showTimes) {
+  std::vector<std::string> entries, objects;
+  for (auto &file : filenames)
+    (fs::path(file).extension() == ".gu" ? entries : objects).push_back(file);
+
+  std::error_code ec;
+  if (!outDir.empty() && !fs::create_directories(outDir, ec) && ec) {
+    std::cerr << "Was not possible to create the directory " << outDir
+              << "\n";
+    exit(1);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<PhaseTimes> times(entries.size());
+  std::atomic<size_t> next{0};
+  auto worker = [&]() {
+    for (size_t i; (i = next++) < entries.size();) {
+      AstArena arena;
+      AstArena::setCurrent(&arena);
+      compileFile(options, entries[i],
+                  batchOutput(entries[i], options.asmType, outDir), objects,
+                  times[i]);
+      AstArena::setCurrent(nullptr);
+    }
+  };
+
+  jobs = std::max(1u, std::min<unsigned>(jobs, entries.size()));
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < jobs; i++)
+    threads.emplace_back(worker);
+  worker();
+  for (auto &thread : threads)
+    thread.join();
+
+  if (showTimes)
+    printTimes(times, jobs, lap(start));
+}
+
 int main(int argc, char **argv) {
   ArgHandler argHandler{};
   argHandler.defArg("assembly", {"asm", "obj", "basicIR", "IR"}, "S");
   argHandler.defArg("output", {}, "o");
   argHandler.defArg("compile", {""}, "c", true);
   argHandler.defArg("opt", {"0", "1", "2", "3"}, "O");
+  argHandler.defArg("shared-generics", {""}, "G", true);
+  argHandler.defArg("interface", {""}, "i", true);
+  argHandler.defArg("modules", {""}, "M", true);
+  argHandler.defArg("cache", {""}, "C", true);
+  argHandler.defArg("cache-stats", {""}, "", true);
+  argHandler.defArg("jobs", {}, "j");
+  argHandler.defArg("time", {""}, "", true);
 
   argHandler.parseArgs(argc, argv);
 
@@ -87,6 +301,18 @@ int main(int argc, char **argv) {
   auto [opresent, outputName] = argHandler.getArg("output");
   auto [cpresent, _] = argHandler.getArg("compile");
   auto [optpresent, optValue] = argHandler.getArg("opt");
+  auto [sharedpresent, __] = argHandler.getArg("shared-generics");
+  auto [ipresent, ___] = argHandler.getArg("interface");
+  auto [mpresent, ____] = argHandler.getArg("modules");
+  auto [cachepresent, _____] = argHandler.getArg("cache");
+  auto [statspresent, ______] = argHandler.getArg("cache-stats");
+  auto [jpresent, jobsValue] = argHandler.getArg("jobs");
+  auto [timepresent, _______] = argHandler.getArg("time");
+
+  if (statspresent) {
+    CompileCache::printStats();
+    return 0;
+  }
 
   if (!asmpresent)
     asmType = "obj";
@@ -99,31 +325,52 @@ int main(int argc, char **argv) {
         "Expecting at least one file and possibly some object files");
   auto filename = filenames[0];
 
-  SemanticValidator validator(!cpresent);
-  Assembler assembler(!cpresent);
-
-  auto programAst = getProgramAst(filename, filenames);
-  runValidator(programAst, &validator);
-  runAssembler(programAst, &assembler);
+  if (ipresent) {
+    buildInterface(filename,
+                   opresent ? outputName
+                            : std::filesystem::path(filename)
+                                  .replace_extension(".gpi")
+                                  .string());
+    return 0;
+  }
 
-  bool toBinary = asmType == "exec";
-  std::string outName = opresent ? outputName : "a.o";
+  char optLevel = optpresent ? optValue[0] : '2';
 
-  compile(&assembler, toBinary ? "a.o" : outName,
-          optpresent ? optValue[0] : '2', asmType);
+  CompileOptions options;
+  options.asmType = asmType;
+  options.optLevel = optLevel;
+  options.withEntrypoint = !cpresent;
+  options.sharedGenerics = sharedpresent;
+  options.modules =
+      mpresent ? new ModuleCache(optLevel, sharedpresent) : nullptr;
+  options.cache = cachepresent;
+  options.cacheFlags = asmType + " -O " + optLevel + (cpresent ? " -c" : "") +
+                       (sharedpresent ? " -G" : "") + (mpresent ? " -M" : "");
 
-  if (toBinary) {
-    std::string ldCommand = "ld a.o -o " + outName + " ";
-    for (ulint i = 1; i < filenames.size(); i++)
-      ldCommand += " " + filenames[i] + " ";
-    ldCommand += getLoaderSuffix();
-    int result = system(ldCommand.c_str());
-    system("rm a.o");
-    if (result) {
-      std::cerr << "There are errors during the linking phase\n";
-      exit(1);
-    }
+  // Only -j turns -o into a directory, a single output never becomes one
+  if (jpresent) {
+    int jobs = std::atoi(jobsValue.c_str());
+    if (jobs < 1)
+      argHandler.parseError("Invalid number of jobs: " + jobsValue);
+    compileBatch(options, filenames, opresent ? outputName : "", jobs,
+                 timepresent);
+    return 0;
   }
 
+  auto sources = std::count_if(
+      filenames.begin(), filenames.end(),
+      [](auto &file) { return fs::path(file).extension() == ".gu"; });
+  if (sources > 1)
+    argHandler.parseError(
+        "Expecting a single .gu file, several are compiled apart with -j");
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<PhaseTimes> times(1);
+  compileFile(options, filename, opresent ? outputName : "a.o",
+              std::vector<std::string>(filenames.begin() + 1,
+                                       filenames.end()),
+              times[0]);
+  if (timepresent)
+    printTimes(times, 1, lap(start));
   return 0;
-}
\ No newline at end of file
+}
@@ -1,7 +1,8 @@
 #include "parser.h"
 #include "../ast/ast.h"
+#include <array>
 
-std::map<std::string, int> baseTypeMapper = {
+constexpr TokenEntry baseTokens[] = {
     {"import", ProgramTokenType::IMPORT},
     {"declarationfile", ProgramTokenType::DECLARATION_FILE},
     {"export", ProgramTokenType::EXPORT},
@@ -51,8 +52,6 @@ std::map<std::string, int> baseTypeMapper = {
     {";", ProgramTokenType::SEMICOLON},
     {"->", ProgramTokenType::RET_TYPE},
     {":", ProgramTokenType::IND_TYPE},
-    {"/*", ProgramTokenType::OPEN_COMMENT},
-    {"*/", ProgramTokenType::CLOSE_COMMENT},
 
     {"_LEXER__NUMBER__", ProgramTokenType::LEX_NUMBER},
     {"_LEXER__STRING__", ProgramTokenType::LEX_STRING},
@@ -60,31 +59,53 @@ std::map<std::string, int> baseTypeMapper = {
     {"_LEXER__IDENTIFIER__", ProgramTokenType::IDENTIFIER},
 };
 
-std::map<std::string, int> binaryOpsPrecedence = {
-    {".", 0},  {"[", 0},  {"(", 0},
+constexpr TokenTable baseTypeMapper(baseTokens);
+static_assert(baseTypeMapper.isPerfect(),
+              "No perfect hash seed was found for the token table");
 
-    {"*", 1},  {"/", 1},  {"%", 1},
-
-    {"+", 2},  {"-", 2},
-
-    {"<<", 3}, {">>", 3},
-
-    {">", 4},  {">=", 4}, {"<", 4}, {"<=", 4},
-
-    {"!=", 5}, {"==", 5},
-
-    {"&", 6},
-
-    {"|", 7},  {"^", 7},
-
-    {"&&", 8},
-
-    {"||", 9},
-
-    {"=", 10},
+struct BinaryOperator {
+  int precedence;
+  ExprOperator op;
+  bool rightAssoc;
 };
 
-std::unordered_set<std::string> unaryOps = {"+", "-", "!", "&", "*"};
+/*
+  Binary operators indexed by token type, a higher precedence binds tighter
+  and 0 means the token does not continue the expression
+*/
+constexpr auto binaryOperators = [] {
+  std::array<BinaryOperator, PROGRAM_TOKEN_TYPES> table{};
+  table[ASSIGN] = {1, ExprOperator::ASSIGN, true};
+  table[OR] = {2, ExprOperator::OR, false};
+  table[AND] = {3, ExprOperator::AND, false};
+  table[B_OR] = {4, ExprOperator::B_OR, false};
+  table[B_XOR] = {4, ExprOperator::B_XOR, false};
+  table[B_AND] = {5, ExprOperator::B_AND, false};
+  table[EQ] = {6, ExprOperator::EQ, false};
+  table[NEQ] = {6, ExprOperator::NEQ, false};
+  table[GT] = {7, ExprOperator::GT, false};
+  table[GTE] = {7, ExprOperator::GTE, false};
+  table[LT] = {7, ExprOperator::LT, false};
+  table[LTE] = {7, ExprOperator::LTE, false};
+  table[B_LSHIFT] = {8, ExprOperator::B_LSHIFT, false};
+  table[B_RSHIFT] = {8, ExprOperator::B_RSHIFT, false};
+  table[PLUS] = {9, ExprOperator::PLUS, false};
+  table[MINUS] = {9, ExprOperator::MINUS, false};
+  table[MULT] = {10, ExprOperator::MULT, false};
+  table[DIV] = {10, ExprOperator::DIV, false};
+  table[MOD] = {10, ExprOperator::MOD, false};
+  return table;
+}();
+
+constexpr auto unaryOperators = [] {
+  std::array<ExprOperator, PROGRAM_TOKEN_TYPES> table{};
+  table[PLUS] = ExprOperator::PLUS;
+  table[MINUS] = ExprOperator::MINUS;
+  table[MULT] = ExprOperator::MULT;
+  table[B_AND] = ExprOperator::B_AND;
+  table[NOT] = ExprOperator::NOT;
+  return table;
+}();
 
 std::map<std::string, std::string> assignTransformMap{
     {"=", ""},   {"+=", "+"}, {"-=", "-"}, {"*=", "*"},   {"/=", "/"},
@@ -98,17 +119,15 @@ AstParser::AstParser(Lexer *lexer) {
 }
 
 /*
-  PROGRAM: (FUNCTION | VAR_DEF)*
+  PROGRAM: ((CONST | HOT)? FUNCTION | VAR_DEF)*
 */
 ProgramNode *AstParser::parseProgram() {
-  auto node = new ProgramNode(lexer->getFileName(), currLine(), currCol());
+  auto node = new ProgramNode(currLoc());
 
-  auto firstToken = lexer->get();
-  if (firstToken.mappedType == DECLARATION_FILE) {
+  if (nextOptional(DECLARATION_FILE)) {
     declaring = true;
     nextExpected(SEMICOLON, "Expecting semicolon");
-  } else
-    lexer->unget();
+  }
 
   while (lexer->get().rawType != TokenType::END_OF_INPUT) {
     auto current = lexer->look();
@@ -120,10 +139,14 @@ ProgramNode *AstParser::parseProgram() {
     case VAR:
     case CONST: {
       bool constant = current.mappedType == CONST;
+      if (constant && nextOptional(FUNC)) {
+        parseFunction(node)->_constant = true;
+        break;
+      }
+
       parseVarDef(node, constant);
 
-      while ((lexer->get()).mappedType != SEMICOLON) {
-        lexer->unget();
+      while (!nextOptional(SEMICOLON)) {
         nextExpected(COMMA, "Expecting , or ;");
         parseVarDef(node, constant);
       }
@@ -132,6 +155,11 @@ ProgramNode *AstParser::parseProgram() {
     case STRUCT:
       parseStruct(node);
       break;
+    case IDENTIFIER:
+      if (current.raw != "hot" || !nextOptional(FUNC))
+        sintax_error("Unexpected token: " + std::string(current.raw));
+      parseFunction(node)->_hot = true;
+      break;
     case IMPORT:
       parseImport(node);
       break;
@@ -143,11 +171,8 @@ ProgramNode *AstParser::parseProgram() {
 
       exporting = true;
       break;
-    case OPEN_COMMENT:
-      parseComment();
-      break;
     default:
-      sintax_error("Unexpected token: " + current.raw);
+      sintax_error("Unexpected token: " + std::string(current.raw));
     }
   }
 
@@ -167,45 +192,41 @@ void AstParser::parseImport(ProgramNode *parent) {
     return;
   }
   auto isRawImport = importFrom.mappedType == LEX_STRING;
-  parent->imports.push_back({importFrom.raw, isRawImport});
+  parent->imports.push_back({std::string(importFrom.raw), isRawImport});
   nextExpected(SEMICOLON, "Expecting semicolon after import statement");
 }
 
 /*
-  COMMENT: OPEN_COMMENT ANY* CLOSE_COMMENT
-*/
-void AstParser::parseComment() {
-  Token token;
-  while ((token = lexer->get()).mappedType != CLOSE_COMMENT) {
-    if (token.rawType == TokenType::END_OF_INPUT)
-      sintax_error("Unclosed comment");
-  }
-}
-
-/*
-  FUNCTION: IDENTIFIER OPEN_PAR VAR_DEF? [ COMMA VAR_DEF ]* CLOSE_PAR RET_TYPE
-  TYPE BLOCK
+  FUNCTION: IDENTIFIER [ LT IDENTIFIER [ COMMA IDENTIFIER ]* GT ]? OPEN_PAR
+  VAR_DEF? [ COMMA VAR_DEF ]* CLOSE_PAR RET_TYPE TYPE BLOCK
 */
 FunctionNode *AstParser::parseFunction(AstNode *parent) {
   Token ident = nextExpected(IDENTIFIER, "Expecting identifier");
 
-  auto node = new FunctionNode(lexer->getFileName(), currLine(), currCol(),
-                               parent, ident.raw);
+  auto node = new FunctionNode(currLoc(), parent, ident.symbol);
   function = node;
   function->_export = exporting;
   exporting = false;
 
+  if (nextOptional(OPEN_GENERIC_TYPE)) {
+    auto token = nextExpected(IDENTIFIER, "Expecting type identifier");
+    node->_genericArgNames.push_back(token.symbol);
+    while (nextOptional(COMMA)) {
+      token = nextExpected(IDENTIFIER, "Expecting type identifier");
+      node->_genericArgNames.push_back(token.symbol);
+    }
+    nextExpected(CLOSE_GENERIC_TYPE, "Expecting end of generic params list");
+  }
+
   nextExpected(OPEN_PAR, "Expecting (");
 
-  if (lexer->get().mappedType != CLOSE_PAR) {
-    lexer->unget();
+  if (lexer->peek().mappedType != CLOSE_PAR) {
     node->_params.push_back(parseVarDef(node));
 
-    while (lexer->get().mappedType == COMMA) {
+    while (nextOptional(COMMA)) {
       node->_params.push_back(parseVarDef(node));
     }
   }
-  lexer->unget();
 
   nextExpected(CLOSE_PAR, "Expecting )");
   nextExpected(RET_TYPE, "Expecting ->");
@@ -223,38 +244,52 @@ FunctionNode *AstParser::parseFunction(AstNode *parent) {
 }
 
 /*
-  STRUCT: IDENTIFIER OPEN_BRACES [ (VAR_DEF | FUNCTION) SEMICOLON ]*
-  CLOSE_BRACES
+  STRUCT: IDENTIFIER [ LT GENERIC_PARAM [ COMMA GENERIC_PARAM ]* GT ]?
+  OPEN_BRACES [ (VAR_DEF | FUNCTION) SEMICOLON ]* CLOSE_BRACES
+  GENERIC_PARAM: IDENTIFIER [ IND_TYPE TYPE_DEF [ ASSIGN LEX_NUMBER ]? ]?
 */
 StructDefNode *AstParser::parseStruct(AstNode *parent) {
   Token token = nextExpected(IDENTIFIER, "Expecting identifier");
-  auto node = new StructDefNode(lexer->getFileName(), currLine(), currCol(),
-                                parent, token.raw);
+  auto node = new StructDefNode(currLoc(), parent, token.symbol);
   node->_export = exporting;
   exporting = false;
   node->_external = declaring;
 
-  if (lexer->get().mappedType == OPEN_GENERIC_TYPE) {
-    auto token = nextExpected(IDENTIFIER, "Expecting type identifier");
-    node->_genericArgNames.push_back(token.raw);
-    while (lexer->get().mappedType == COMMA) {
-      token = nextExpected(IDENTIFIER, "Expecting type identifier");
-      node->_genericArgNames.push_back(token.raw);
-    }
-    lexer->unget();
+  if (nextOptional(OPEN_GENERIC_TYPE)) {
+    do {
+      auto token = nextExpected(IDENTIFIER, "Expecting type identifier");
+      node->_genericArgNames.push_back(token.symbol);
+      auto type = nextOptional(IND_TYPE) ? parseTypeDef(node) : nullptr;
+      node->_genericArgTypes.push_back(type);
+
+      auto &defaults = node->_genericArgDefaults;
+      if (type && nextOptional(ASSIGN)) {
+        if (lexer->peek().mappedType != LEX_NUMBER)
+          sintax_error("Expecting a default integer template argument");
+        defaults.push_back(parseGenericArg(node));
+      } else if (!defaults.empty() && defaults.back()) {
+        sintax_error("Expecting a default, template parameters after a "
+                     "defaulted one need one too");
+      } else {
+        defaults.push_back(nullptr);
+      }
+    } while (nextOptional(COMMA));
     nextExpected(CLOSE_GENERIC_TYPE, "Expecting end of generic params list");
-  } else
-    lexer->unget();
+  }
 
   nextExpected(OPEN_BRACES, "Expecting {");
 
-  while ((token = lexer->get()).mappedType != CLOSE_BRACES) {
-    if (lexer->look().mappedType == FUNC) {
+  while (!nextOptional(CLOSE_BRACES)) {
+    if (isHotFunction()) {
+      lexer->get();
+      lexer->get();
+      auto func = parseFunction(node);
+      func->_hot = true;
+      node->_members.push_back(func);
+    } else if (nextOptional(FUNC))
       node->_members.push_back(parseFunction(node));
-    } else {
-      lexer->unget();
+    else
       node->_members.push_back(parseVarDef(node));
-    }
     nextExpected(SEMICOLON, "Expecting semicolon");
   }
 
@@ -267,13 +302,14 @@ StructDefNode *AstParser::parseStruct(AstNode *parent) {
 BodyNode *AstParser::parseBlock(AstNode *parent) {
   nextExpected(OPEN_BRACES, "Expecting {");
 
-  auto node = new BodyNode(lexer->getFileName(), currLine(), currCol(), parent);
+  auto node = new BodyNode(currLoc(), parent);
 
-  while (lexer->get().mappedType != CLOSE_BRACES) {
-    if (lexer->look().rawType == TokenType::END_OF_INPUT)
+  while (!nextOptional(CLOSE_BRACES)) {
+    if (lexer->peek().rawType == TokenType::END_OF_INPUT) {
+      lexer->get();
       sintax_error("Unexpected EOF reading block");
+    }
 
-    lexer->unget();
     node->_statements.push_back(parseStatement(node));
   }
 
@@ -284,31 +320,22 @@ BodyNode *AstParser::parseBlock(AstNode *parent) {
   STATEMENT: IF | FOR | WHILE | VAR_DEF | BREAK | RETURN | EXPR
 */
 AstNode *AstParser::parseStatement(AstNode *parent) {
-  Token token;
-
-  while ((token = lexer->get()).mappedType == OPEN_COMMENT)
-    parseComment();
-
-  switch (token.mappedType) {
+  switch (lexer->peek().mappedType) {
   case IF:
-    lexer->unget();
     return parseIf(parent);
   case FOR:
-    lexer->unget();
     return parseFor(parent);
   case WHILE:
-    lexer->unget();
     return parseWhile(parent);
   case CONST:
   case VAR: {
     auto block = (BodyNode *)parent;
 
-    bool constant = token.mappedType == CONST;
+    bool constant = lexer->get().mappedType == CONST;
     auto node = parseVarDef(parent, constant);
     function->_innerVars.push_back(node);
 
-    while ((lexer->get()).mappedType != SEMICOLON) {
-      lexer->unget();
+    while (!nextOptional(SEMICOLON)) {
       nextExpected(COMMA, "Expecting , or ;");
       block->_statements.push_back(parseVarDef(parent, constant));
     }
@@ -316,20 +343,19 @@ AstNode *AstParser::parseStatement(AstNode *parent) {
     return node;
   }
   case BREAK: {
-    auto node =
-        new BreakNode(lexer->getFileName(), currLine(), currCol(), parent);
+    lexer->get();
+    auto node = new BreakNode(currLoc(), parent);
     nextExpected(SEMICOLON, "Expecting semicolon after break");
     return node;
   }
   case RETURN: {
-    auto node =
-        new ReturnNode(lexer->getFileName(), currLine(), currCol(), parent);
+    lexer->get();
+    auto node = new ReturnNode(currLoc(), parent);
     node->_expr = parseExpr(node);
     nextExpected(SEMICOLON, "Expecting semicolon after return");
     return node;
   }
   default: {
-    lexer->unget();
     auto node = parseExpr(parent);
     nextExpected(SEMICOLON, "Expecting semicolon after expression");
     return node;
@@ -343,16 +369,13 @@ AstNode *AstParser::parseStatement(AstNode *parent) {
 IfNode *AstParser::parseIf(AstNode *parent) {
   nextExpected(IF, "Expecting IF");
 
-  auto node = new IfNode(lexer->getFileName(), currLine(), currCol(), parent);
+  auto node = new IfNode(currLoc(), parent);
 
   node->_expr = parseExpr(node);
   node->_ifBody = parseBlock(node);
 
-  auto token = lexer->get();
-  if (token.mappedType == ELSE)
+  if (nextOptional(ELSE))
     node->_elseBody = parseBlock(node);
-  else
-    lexer->unget();
 
   return node;
 }
@@ -363,7 +386,7 @@ IfNode *AstParser::parseIf(AstNode *parent) {
 ForNode *AstParser::parseFor(AstNode *parent) {
   nextExpected(FOR, "Expecting FOR");
 
-  auto node = new ForNode(lexer->getFileName(), currLine(), currCol(), parent);
+  auto node = new ForNode(currLoc(), parent);
 
   nextExpected(OPEN_PAR, "Expecting (");
 
@@ -385,8 +408,7 @@ ForNode *AstParser::parseFor(AstNode *parent) {
 */
 WhileNode *AstParser::parseWhile(AstNode *parent) {
   nextExpected(WHILE, "Expecting WHILE");
-  auto node =
-      new WhileNode(lexer->getFileName(), currLine(), currCol(), parent);
+  auto node = new WhileNode(currLoc(), parent);
 
   node->_expr = parseExpr(node);
   node->_body = parseBlock(node);
@@ -401,8 +423,7 @@ WhileNode *AstParser::parseWhile(AstNode *parent) {
 VarDefNode *AstParser::parseVarDef(AstNode *parent, bool constant) {
   auto token = nextExpected(IDENTIFIER, "Expecting identifier");
 
-  auto node = new VarDefNode(lexer->getFileName(), currLine(), currCol(),
-                             parent, token.raw, constant);
+  auto node = new VarDefNode(currLoc(), parent, token.symbol, constant);
   node->_export = exporting;
   exporting = false;
   node->_external = declaring;
@@ -410,27 +431,22 @@ VarDefNode *AstParser::parseVarDef(AstNode *parent, bool constant) {
   nextExpected(IND_TYPE, "Expecting type indicator");
   node->_typeDef = parseTypeDef(node);
 
-  token = lexer->get();
-  if (token.mappedType == OPEN_PAR) {
+  if (nextOptional(OPEN_PAR)) {
     node->_initArgs.push_back(parseExpr(node));
-    while (lexer->get().mappedType == COMMA)
+    while (nextOptional(COMMA))
       node->_initArgs.push_back(parseExpr(node));
-    lexer->unget();
     nextExpected(CLOSE_PAR, "Expecting ) closing init args");
-  } else
-    lexer->unget();
+  }
 
-  token = lexer->get();
-  if (token.mappedType == ASSIGN) {
+  if (nextOptional(ASSIGN))
     node->_defaultVal = parseExpr(node);
-  } else
-    lexer->unget();
 
   return node;
 }
 
 /*
-  TYPE_DEF: IDENTIFIER [ OPEN_BRACKETS LEX_NUMBER CLOSE_BRACKETS ]* |
+  TYPE_DEF: IDENTIFIER [ OPEN_BRACKETS (LEX_NUMBER | IDENTIFIER)
+            CLOSE_BRACKETS ]* [ LT GENERIC_ARG [ COMMA GENERIC_ARG ]* GT ]? |
             MULT OPEN_PAR TYPE_DEF CLOSE_PAR
 */
 TypeDefNode *AstParser::parseTypeDef(AstNode *parent) {
@@ -439,15 +455,9 @@ TypeDefNode *AstParser::parseTypeDef(AstNode *parent) {
   TypeDefNode *node;
 
   if (token.mappedType == MULT) {
-    token = lexer->get();
+    bool matchParam = nextOptional(OPEN_PAR);
 
-    bool matchParam = token.mappedType == OPEN_PAR;
-
-    if (token.mappedType != OPEN_PAR)
-      lexer->unget();
-
-    node = TypeDefNode::buildPointer(parseTypeDef(parent), lexer->getFileName(),
-                                     currLine(), currCol());
+    node = TypeDefNode::buildPointer(parseTypeDef(parent), currLoc());
     node->_parent = parent;
     parent->_children.push_back(node);
 
@@ -460,25 +470,26 @@ TypeDefNode *AstParser::parseTypeDef(AstNode *parent) {
   if (token.mappedType != IDENTIFIER)
     sintax_error("Expecting identifier");
 
-  node = TypeDefNode::build(token.raw, lexer->getFileName(), currLine(),
-                            currCol());
+  node = TypeDefNode::build(token.symbol, currLoc());
 
-  while ((token = lexer->get()).mappedType == OPEN_BRACKETS) {
-    token = nextExpected(LEX_NUMBER, "Expecting array size");
-    node = TypeDefNode::buildArray(node, lexer->getFileName(),
-                                   std::stoi(token.raw), currLine(), currCol());
+  while (nextOptional(OPEN_BRACKETS)) {
+    token = lexer->get();
+    if (token.mappedType == IDENTIFIER) {
+      node = TypeDefNode::buildArray(node, 0, currLoc());
+      node->_arrSizeParam = token.symbol;
+    } else {
+      if (token.mappedType != LEX_NUMBER || token.isFloat)
+        sintax_error("Expecting array size");
+      node = TypeDefNode::buildArray(node, token.intValue, currLoc());
+    }
     nextExpected(CLOSE_BRACKETS, "Expecting ]");
   }
-  if (lexer->look().mappedType == OPEN_GENERIC_TYPE) {
-    node->_genericArgsDefs.push_back(parseTypeDef(node));
-    while (lexer->get().mappedType == COMMA) {
-      token = nextExpected(IDENTIFIER, "Expecting type identifier");
-      node->_genericArgsDefs.push_back(parseTypeDef(node));
-    }
-    lexer->unget();
+  if (nextOptional(OPEN_GENERIC_TYPE)) {
+    do {
+      node->_genericArgsDefs.push_back(parseGenericArg(node));
+    } while (nextOptional(COMMA));
     nextExpected(CLOSE_GENERIC_TYPE, "Expecting end of generic params list");
-  } else
-    lexer->unget();
+  }
 
   node->_parent = parent;
   parent->_children.push_back(node);
@@ -486,117 +497,102 @@ TypeDefNode *AstParser::parseTypeDef(AstNode *parent) {
   return node;
 }
 
+/*
+  GENERIC_ARG: TYPE_DEF | LEX_NUMBER
+*/
+TypeDefNode *AstParser::parseGenericArg(AstNode *parent) {
+  if (lexer->peek().mappedType != LEX_NUMBER)
+    return parseTypeDef(parent);
+
+  auto token = lexer->get();
+  if (token.isFloat)
+    sintax_error("Expecting an integer template argument");
+
+  auto node = TypeDefNode::build(std::to_string(token.intValue), currLoc());
+  node->_valueArg = true;
+  node->_value = token.intValue;
+  node->_parent = parent;
+  parent->_children.push_back(node);
+  return node;
+}
+
 /*
   EXPR: EXPR OP EXPR | ATOM | ATOM OPEN_PAR [EXPR]* CLOSE_PAR | ATOM
   OPEN_BRACKETS EXPR CLOSE_BRACKETS
 */
 ExprNode *AstParser::parseExpr(AstNode *parent) {
-  if (lexer->get().mappedType == SEMICOLON) {
-    lexer->unget();
+  if (lexer->peek().mappedType == SEMICOLON)
     return nullptr;
-  }
-  lexer->unget();
-
-  std::stack<ExprNode *> operands;
-  std::stack<Token> operators;
-
-  operands.push(parseAtom(nullptr));
-
-  auto clearStack = [&](std::stack<ExprNode *> &operands,
-                        std::stack<Token> &operators, int level = 0xFF) {
-    while (!operators.empty() &&
-           binaryOpsPrecedence[operators.top().raw] < level) {
-      Token op = operators.top();
-      operators.pop();
-      auto right = operands.top();
-      operands.pop();
-      auto left = operands.top();
-      operands.pop();
-
-      operands.push(new ExprBinaryNode(lexer->getFileName(), currLine(),
-                                       currCol(), nullptr, left, op.raw,
-                                       op.mappedType, right));
-    }
-  };
-
-  auto processIndex = [&](std::stack<ExprNode *> &operands) {
-    auto index = parseExpr();
-    auto expr = operands.top();
-    operands.pop();
-    auto node = new ExprIndex(lexer->getFileName(), currLine(), currCol(),
-                              nullptr, expr, index);
-    nextExpected(CLOSE_BRACKETS, "Expecting ]");
-    operands.push(node);
-  };
-
-  auto processCall = [&](std::stack<ExprNode *> &operands) {
-    auto funcRef = operands.top();
-    operands.pop();
-    auto node = new ExprCallNode(lexer->getFileName(), currLine(), currCol(),
-                                 nullptr, funcRef);
-
-    if ((lexer->get()).mappedType == CLOSE_PAR) {
-      operands.push(node);
-      return;
-    }
-    lexer->unget();
-
-    node->_args.push_back(parseExpr(node));
 
-    while ((lexer->get()).mappedType != CLOSE_PAR) {
-      lexer->unget();
-      nextExpected(COMMA, "Expecting ,");
-      node->_args.push_back(parseExpr(node));
-    }
-
-    operands.push(node);
-  };
+  auto node = parseBinary(1);
+  node->_parent = parent;
+  if (parent)
+    parent->_children.push_back(node);
+  return node;
+}
 
-  auto processMemberAccess = [&](std::stack<ExprNode *> &operands) {
-    auto structRef = operands.top();
-    operands.pop();
-    auto ident = nextExpected(IDENTIFIER, "Expecting identifier");
-    auto node = new ExprMemberAccess(lexer->getFileName(), currLine(),
-                                     currCol(), nullptr, structRef, ident.raw);
-    operands.push(node);
-  };
+/*
+  Precedence climbing, operators of the same level group to the left except
+  the assignment
+*/
+ExprNode *AstParser::parseBinary(int minPrecedence) {
+  auto left = parsePostfix(parseAtom(nullptr));
 
-  Token token;
   while (true) {
-    token = lexer->get();
-    auto precedenceIt = binaryOpsPrecedence.find(token.raw);
+    auto op = binaryOperators[lexer->peek().mappedType];
+    if (!op.precedence || op.precedence < minPrecedence)
+      return left;
+
+    lexer->get();
+    auto loc = currLoc();
+    auto right = parseBinary(op.rightAssoc ? op.precedence : op.precedence + 1);
+    left = new ExprBinaryNode(loc, nullptr, left, op.op, right);
+  }
+}
 
-    if (precedenceIt == binaryOpsPrecedence.end()) {
-      lexer->unget();
-      clearStack(operands, operators);
+/*
+  POSTFIX: ATOM [DOT IDENTIFIER | OPEN_BRACKETS EXPR CLOSE_BRACKETS |
+  OPEN_PAR [EXPR]* CLOSE_PAR]*
+*/
+ExprNode *AstParser::parsePostfix(ExprNode *expr) {
+  while (true) {
+    switch (lexer->peek().mappedType) {
+    case DOT: {
+      lexer->get();
+      auto ident = nextExpected(IDENTIFIER, "Expecting identifier");
+      expr = new ExprMemberAccess(currLoc(), nullptr, expr, ident.symbol);
+      break;
+    }
+    case OPEN_BRACKETS: {
+      lexer->get();
+      auto index = parseExpr();
+      nextExpected(CLOSE_BRACKETS, "Expecting ]");
+      expr = new ExprIndex(currLoc(), nullptr, expr, index);
+      break;
+    }
+    case OPEN_PAR:
+      lexer->get();
+      expr = parseCall(expr);
       break;
+    default:
+      return expr;
     }
+  }
+}
 
-    int level = precedenceIt->second;
-    clearStack(operands, operators, level);
+ExprCallNode *AstParser::parseCall(ExprNode *funcRef) {
+  auto node = new ExprCallNode(currLoc(), nullptr, funcRef);
 
-    if (level > 0) {
-      operators.push(token);
-      operands.push(parseAtom(nullptr));
-    } else {
-      switch (token.raw[0]) {
-      case '.':
-        processMemberAccess(operands);
-        break;
-      case '[':
-        processIndex(operands);
-        break;
-      case '(':
-        processCall(operands);
-        break;
-      }
-    }
+  if (nextOptional(CLOSE_PAR))
+    return node;
+
+  node->_args.push_back(parseExpr(node));
+
+  while (!nextOptional(CLOSE_PAR)) {
+    nextExpected(COMMA, "Expecting ,");
+    node->_args.push_back(parseExpr(node));
   }
 
-  auto node = operands.top();
-  node->_parent = parent;
-  if (parent)
-    parent->_children.push_back(node);
   return node;
 }
 
@@ -608,19 +604,23 @@ ExprNode *AstParser::parseAtom(AstNode *parent) {
   Token token = lexer->get();
 
   switch (token.mappedType) {
-  case LEX_CHAR:
   case LEX_STRING:
+    return new ExprConstantNode(currLoc(), parent, std::string(token.raw),
+                                token.mappedType);
+  case LEX_CHAR:
   case LEX_NUMBER:
-    return new ExprConstantNode(lexer->getFileName(), currLine(), currCol(),
-                                parent, token.raw, token.mappedType);
+    if (token.isFloat)
+      return new ExprConstantNode(currLoc(), parent, std::string(token.raw),
+                                  token.mappedType, token.floatValue);
+    return new ExprConstantNode(currLoc(), parent, std::string(token.raw),
+                                token.mappedType, token.intValue);
   case OPEN_PAR: {
     auto node = parseExpr(parent);
     nextExpected(CLOSE_PAR, "Expecting )");
     return node;
   }
   case IDENTIFIER: {
-    auto node = new ExprVarRefNode(lexer->getFileName(), currLine(), currCol(),
-                                   nullptr, token.raw);
+    auto node = new ExprVarRefNode(currLoc(), nullptr, token.symbol);
 
     node->_parent = parent;
     if (parent)
@@ -628,27 +628,46 @@ ExprNode *AstParser::parseAtom(AstNode *parent) {
 
     return node;
   }
-  default: {
-    if (unaryOps.find(token.raw) == unaryOps.end())
-      sintax_error("Unexpected value reading expression: " + token.raw);
-
+  case PLUS:
+  case MINUS:
+  case MULT:
+  case B_AND:
+  case NOT: {
     auto atom = parseAtom(parent);
-    return new ExprUnaryNode(lexer->getFileName(), currLine(), currCol(),
-                             parent, token.raw, token.mappedType, atom);
+    return new ExprUnaryNode(currLoc(), parent,
+                             unaryOperators[token.mappedType], atom);
   }
+  default:
+    sintax_error("Unexpected value reading expression: " +
+                 std::string(token.raw));
+    return nullptr;
   }
 }
 
 const Token &AstParser::nextExpected(ProgramTokenType expectedType,
                                      std::string errorMsg) {
-  auto token = lexer->get();
+  auto &token = lexer->get();
   if (token.mappedType != expectedType)
-    sintax_error(errorMsg + ", got " + token.raw);
-  return lexer->look();
+    sintax_error(errorMsg + ", got " + std::string(token.raw));
+  return token;
+}
+
+// hot is only a keyword before func, it stays a valid identifier
+bool AstParser::isHotFunction() {
+  auto &token = lexer->peek();
+  return token.mappedType == IDENTIFIER && token.raw == "hot" &&
+         lexer->peek(1).mappedType == FUNC;
+}
+
+bool AstParser::nextOptional(ProgramTokenType type) {
+  if (lexer->peek().mappedType != type)
+    return false;
+
+  lexer->get();
+  return true;
 }
 
 void AstParser::sintax_error(std::string msg) {
-  auto current = lexer->look();
   std::cerr << lexer->getFileName() + ":" + std::to_string(currLine()) + ":" +
                    std::to_string(currCol())
             << " sintax error: " << msg << std::endl;
@@ -73,10 +73,10 @@ enum ProgramTokenType {
   SEMICOLON,
   IND_TYPE,
   RET_TYPE,
+
+  PROGRAM_TOKEN_TYPES,
   OPEN_GENERIC_TYPE = LT,
   CLOSE_GENERIC_TYPE = GT,
-  OPEN_COMMENT,
-  CLOSE_COMMENT,
 };
 
 class AstParser {
@@ -103,16 +103,25 @@ private:
   ForNode *parseFor(AstNode *parent);
   VarDefNode *parseVarDef(AstNode *parent, bool constant = false);
   TypeDefNode *parseTypeDef(AstNode *parent);
+  TypeDefNode *parseGenericArg(AstNode *parent);
 
+  ExprNode *parseBinary(int minPrecedence);
+  ExprNode *parsePostfix(ExprNode *expr);
+  ExprCallNode *parseCall(ExprNode *funcRef);
   ExprNode *parseAtom(AstNode *parent);
-  void parseComment();
 
   const Token &nextExpected(ProgramTokenType expectedType,
                             std::string errorMsg);
+  // Consumes the next token only when it has the given type
+  bool nextOptional(ProgramTokenType type);
+  bool isHotFunction();
   void sintax_error(std::string msg);
 
   int currLine() { return this->lexer->look().line; }
   int currCol() { return this->lexer->look().start; }
+  SourceLoc currLoc() {
+    return SourceLoc(lexer->getFileId(), currLine(), currCol());
+  }
 };
 
 #endif
\ No newline at end of file
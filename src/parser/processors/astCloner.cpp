@@ -1,11 +1,11 @@
 #include "astCloner.h"
+#include "../parser.h"
 
 void AstCloner::visitProgram(ProgramNode *node) {}
 
 void AstCloner::visitStructDef(StructDefNode *node) {
   auto newNode =
-      new StructDefNode(node->_filename, node->_line, node->_startCol, nullptr,
-                        prefix + node->_name);
+      new StructDefNode(node->_loc, nullptr, prefix + node->_name.str());
   for (auto member : node->_members) {
     member->visit(this);
     cloned->_parent = newNode;
@@ -18,8 +18,12 @@ void AstCloner::visitStructDef(StructDefNode *node) {
 }
 
 void AstCloner::visitFunction(FunctionNode *node) {
-  auto newNode = new FunctionNode(node->_filename, node->_line, node->_startCol,
-                                  nullptr, prefix + node->_name);
+  auto newNode =
+      new FunctionNode(node->_loc, nullptr, prefix + node->_name.str());
+  newNode->_export = node->_export;
+  newNode->_external = node->_external;
+  newNode->_constant = node->_constant;
+  newNode->_hot = node->_hot;
 
   for (auto param : node->_params) {
     param->visit(this);
@@ -27,39 +31,41 @@ void AstCloner::visitFunction(FunctionNode *node) {
     newNode->_children.push_back(cloned);
     newNode->_params.push_back((VarDefNode *)cloned);
   }
-  for (auto innerVar : node->_innerVars) {
-    innerVar->visit(this);
-    cloned->_parent = newNode;
-    newNode->_children.push_back(cloned);
-    newNode->_innerVars.push_back((VarDefNode *)cloned);
-  }
-  node->_body->visit(this);
-  newNode->_body = (BodyNode *)cloned;
-  cloned->_parent = newNode;
-  newNode->_children.push_back(cloned);
   node->_retTypeDef->visit(this);
   newNode->_retTypeDef = (TypeDefNode *)cloned;
   cloned->_parent = newNode;
   newNode->_children.push_back(cloned);
+  if (node->_body) {
+    node->_body->visit(this);
+    newNode->_body = (BodyNode *)cloned;
+    cloned->_parent = newNode;
+    newNode->_children.push_back(cloned);
+  }
+
+  // Inner vars are the definitions cloned with the body, not new nodes
+  for (auto innerVar : node->_innerVars) {
+    auto found = clonedVars.find(innerVar);
+    if (found != clonedVars.end())
+      newNode->_innerVars.push_back(found->second);
+  }
 
   cloned = newNode;
 }
 
 void AstCloner::visitBody(BodyNode *node) {
-  auto newNode =
-      new BodyNode(node->_filename, node->_line, node->_startCol, nullptr);
+  auto newNode = new BodyNode(node->_loc, nullptr);
   for (auto statement : node->_statements) {
     statement->visit(this);
     cloned->_parent = newNode;
     newNode->_children.push_back(cloned);
+    newNode->_statements.push_back(cloned);
   }
 
   cloned = newNode;
 }
 
 void AstCloner::visitIf(IfNode *node) {
-  auto newNode =
-      new IfNode(node->_filename, node->_line, node->_startCol, nullptr);
+  auto newNode = new IfNode(node->_loc, nullptr);
 
   if (node->_expr) {
     node->_expr->visit(this);
@@ -82,8 +88,7 @@ void AstCloner::visitIf(IfNode *node) {
 }
 
 void AstCloner::visitWhile(WhileNode *node) {
-  auto newNode =
-      new WhileNode(node->_filename, node->_line, node->_startCol, nullptr);
+  auto newNode = new WhileNode(node->_loc, nullptr);
 
   if (node->_expr) {
     node->_expr->visit(this);
@@ -100,8 +105,7 @@ void AstCloner::visitWhile(WhileNode *node) {
 }
 
 void AstCloner::visitFor(ForNode *node) {
-  auto newNode =
-      new ForNode(node->_filename, node->_line, node->_startCol, nullptr);
+  auto newNode = new ForNode(node->_loc, nullptr);
 
   if (node->_start) {
     node->_start->visit(this);
@@ -131,8 +135,8 @@ void AstCloner::visitFor(ForNode *node) {
 }
 
 void AstCloner::visitVarDef(VarDefNode *node) {
-  auto newNode = new VarDefNode(node->_filename, node->_line, node->_startCol,
-                                nullptr, node->_name, node->_constant);
+  auto newNode =
+      new VarDefNode(node->_loc, nullptr, node->_name, node->_constant);
   newNode->_export = node->_export;
   newNode->_external = node->_external;
 
@@ -148,20 +152,38 @@ void AstCloner::visitVarDef(VarDefNode *node) {
     newNode->_children.push_back(cloned);
     cloned->_parent = newNode;
   }
+  for (auto arg : node->_initArgs) {
+    arg->visit(this);
+    newNode->_initArgs.push_back((ExprNode *)cloned);
+    newNode->_children.push_back(cloned);
+    cloned->_parent = newNode;
+  }
 
+  clonedVars[node] = newNode;
   cloned = newNode;
 }
 
 void AstCloner::visitTypeDefNode(TypeDefNode *node) {
-  if (realTypeMapper.find(node->_rawIdent) != realTypeMapper.end()) {
-    cloned = realTypeMapper[node->_rawIdent];
+  if (realTypeMapper.contains(node->_rawIdent)) {
+    cloned = realTypeMapper.lookup(node->_rawIdent);
     return;
   }
 
-  auto newNode = new TypeDefNode(node->_filename, node->_line, node->_startCol);
+  auto newNode = new TypeDefNode(node->_loc);
 
   newNode->_rawIdent = node->_rawIdent;
   newNode->_arrSize = node->_arrSize;
+  newNode->_valueArg = node->_valueArg;
+  newNode->_value = node->_value;
+  newNode->_arrSizeParam = node->_arrSizeParam;
+
+  auto size = node->_arrSizeParam.empty()
+                  ? nullptr
+                  : realTypeMapper.lookup(node->_arrSizeParam);
+  if (size && size->_valueArg) {
+    newNode->_arrSize = size->_value;
+    newNode->_arrSizeParam = Symbol();
+  }
 
   if (node->_arrayOf) {
     node->_arrayOf->visit(this);
@@ -186,17 +208,16 @@ void AstCloner::visitTypeDefNode(TypeDefNode *node) {
 }
 
 void AstCloner::visitBreakNode(BreakNode *node) {
-  auto newNode =
-      new BreakNode(node->_filename, node->_line, node->_startCol, nullptr);
+  auto newNode = new BreakNode(node->_loc, nullptr);
 
   cloned = newNode;
 }
 
 void AstCloner::visitReturnNode(ReturnNode *node) {
-  auto newNode =
-      new ReturnNode(node->_filename, node->_line, node->_startCol, nullptr);
+  auto newNode = new ReturnNode(node->_loc, nullptr);
   if (node->_expr) {
     node->_expr->visit(this);
+    newNode->_expr = (ExprNode *)cloned;
     newNode->_children.push_back(cloned);
     cloned->_parent = newNode;
   }
@@ -211,22 +232,15 @@ void AstCloner::visitExprBinaryOp(ExprBinaryNode *node) {
   auto right = (ExprNode *)cloned;
 
   auto newNode =
-      new ExprBinaryNode(node->_filename, node->_line, node->_startCol, nullptr,
-                         left, node->_op, node->_opNum, right);
-
-  newNode->_children.push_back(left);
-  newNode->_children.push_back(right);
-  left->_parent = newNode;
-  right->_parent = newNode;
+      new ExprBinaryNode(node->_loc, nullptr, left, node->_op, right);
 
   cloned = newNode;
 }
 
 void AstCloner::visitMemberAccess(ExprMemberAccess *node) {
   node->_struct->visit(this);
-  auto newNode =
-      new ExprMemberAccess(node->_filename, node->_line, node->_startCol,
-                           nullptr, (ExprNode *)cloned, node->_memberName);
+  auto newNode = new ExprMemberAccess(node->_loc, nullptr, (ExprNode *)cloned,
+                                      node->_memberName);
   cloned = newNode;
 }
 
@@ -236,8 +250,7 @@ void AstCloner::visitIndexAccess(ExprIndex *node) {
   node->_index->visit(this);
   auto index = (ExprNode *)cloned;
 
-  auto newNode = new ExprIndex(node->_filename, node->_line, node->_startCol,
-                               nullptr, inner, index);
+  auto newNode = new ExprIndex(node->_loc, nullptr, inner, index);
 
   cloned = newNode;
 }
@@ -246,8 +259,7 @@ void AstCloner::visitExprCall(ExprCallNode *node) {
   node->_ref->visit(this);
   auto ref = (ExprNode *)cloned;
 
-  auto newNode = new ExprCallNode(node->_filename, node->_line, node->_startCol,
-                                  nullptr, ref);
+  auto newNode = new ExprCallNode(node->_loc, nullptr, ref);
 
   for (auto arg : node->_args) {
     arg->visit(this);
@@ -263,19 +275,37 @@ void AstCloner::visitExprUnaryOp(ExprUnaryNode *node) {
   node->_expr->visit(this);
 
   auto newNode =
-      new ExprUnaryNode(node->_filename, node->_line, node->_startCol, nullptr,
-                        node->_op, node->_opNum, (ExprNode *)cloned);
+      new ExprUnaryNode(node->_loc, nullptr, node->_op, (ExprNode *)cloned);
 
   cloned = newNode;
 }
 
 void AstCloner::visitExprVarRef(ExprVarRefNode *node) {
-  auto newNode = new ExprVarRefNode(node->_filename, node->_line,
-                                    node->_startCol, nullptr, node->_ident);
+  // Integer parameters become their value, sizeof(T) names the type
+  // parameter as a reference
+  auto ident = node->_ident;
+  auto mapped = realTypeMapper.lookup(ident);
+  if (mapped && mapped->_valueArg) {
+    cloned = new ExprConstantNode(node->_loc, nullptr, mapped->_rawIdent.str(),
+                                  LEX_NUMBER, mapped->_value);
+    return;
+  }
+  if (mapped && !mapped->_pointsTo && !mapped->_arrayOf)
+    ident = mapped->_rawIdent;
+
+  auto newNode = new ExprVarRefNode(node->_loc, nullptr, ident);
+  cloned = newNode;
+}
+
+void AstCloner::visitExprConstant(ExprConstantNode *node) {
+  auto newNode = new ExprConstantNode(node->_loc, nullptr, node->_rawValue,
+                                      node->_rawType, node->_intValue);
+  newNode->_isFloat = node->_isFloat;
+  newNode->elements = node->elements;
   cloned = newNode;
 }
 
-void AstCloner::setUpdateType(std::string original, TypeDefNode *newType) {
+void AstCloner::setUpdateType(Symbol original, TypeDefNode *newType) {
   this->realTypeMapper[original] = newType;
 }
 
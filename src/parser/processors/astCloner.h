@@ -2,6 +2,7 @@
 #define _astCloner
 
 #include "../../ast/ast.h"
+#include <unordered_map>
 
 class AstCloner : public BaseVisitor {
 public:
@@ -26,8 +27,9 @@ public:
 
 
   void visitExprVarRef(ExprVarRefNode *node) override;
+  void visitExprConstant(ExprConstantNode *node) override;
 
-  void setUpdateType(std::string original, TypeDefNode *newType);
+  void setUpdateType(Symbol original, TypeDefNode *newType);
   void clearUpdates();
   void setPrefix(std::string);
   void clearPrefix();
@@ -36,7 +38,8 @@ public:
 private:
   AstNode *cloned = nullptr;
   std::string prefix = "";
-  std::map<std::string, TypeDefNode *> realTypeMapper;
+  SymbolMap<TypeDefNode *> realTypeMapper;
+  std::unordered_map<VarDefNode *, VarDefNode *> clonedVars;
 };
 
 #endif
\ No newline at end of file
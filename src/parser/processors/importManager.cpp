@@ -5,14 +5,17 @@
 namespace fs = std::filesystem;
 
 const char *GU_LIB_ENV_VAR = "GU_LIB_PATH";
+const char *GU_LIB_INDEX_ENV_VAR = "GU_LIB_INDEX";
 const char *homePath = std::getenv("HOME");
 const std::string defaultLibPath =
     "/usr/lib:/usr/local/lib:" + std::string(homePath) + "/.local/lib";
 const char *envLibPathPtr = std::getenv(GU_LIB_ENV_VAR);
 const std::string envLibPath = envLibPathPtr ? envLibPathPtr : "";
 
-ImportManager::ImportManager() {
-  std::string allPaths = defaultLibPath + envLibPath + ":";
+ImportManager::ImportManager(ModuleCache *modules) {
+  this->modules = modules;
+
+  std::string allPaths = defaultLibPath + ":" + envLibPath + ":";
   std::string currPath = "";
 
   for (ulint i = 0; i < allPaths.size(); i++) {
@@ -21,28 +24,16 @@ ImportManager::ImportManager() {
       continue;
     }
 
-    if (!fs::exists(currPath) || !fs::is_directory(currPath)) {
-      currPath = "";
-      continue;
-    }
-
-    for (auto &entry : fs::directory_iterator(currPath)) {
-      if (!entry.is_regular_file())
-        continue;
-
-      auto filename = entry.path().filename().string();
-      auto extension = entry.path().extension().string();
-      if (filename.substr(0, 2) != "GU")
-        continue;
-
-      if (extension == ".o")
-        libFilesO[filename.substr(2, filename.length() - 4)] = entry.path();
-      else if (extension == ".guh")
-        libFilesH[filename.substr(2, filename.length() - 6)] = entry.path();
-    }
-
+    if (!currPath.empty() && fs::is_directory(currPath))
+      libPaths.push_back(currPath);
     currPath = "";
   }
+
+  auto indexPath = std::getenv(GU_LIB_INDEX_ENV_VAR);
+  if (indexPath && *indexPath) {
+    this->indexPath = indexPath;
+    loadIndex();
+  }
 }
 
 void ImportManager::processImports(ProgramNode *program) {
@@ -57,9 +48,13 @@ void ImportManager::processImports(ProgramNode *program) {
 
   for (auto child : storedChildren)
     program->_children.push_back(child);
+
+  if (indexChanged)
+    saveIndex();
 }
 
-void ImportManager::handleFileImports(ProgramNode *program) {
+uint64_t ImportManager::handleFileImports(ProgramNode *program) {
+  uint64_t hash = 0;
   for (auto &import : program->imports) {
     ProgramNode *imported;
     std::string filePath;
@@ -70,31 +65,58 @@ void ImportManager::handleFileImports(ProgramNode *program) {
       filePath = getPackagePath(import.first);
 
     if (visitedFiles.find(filePath) != visitedFiles.end()) {
-      if (visitedFiles[filePath])
+      if (visitedFiles[filePath]) {
+        hash = ModuleCache::combine(hash, importHashes[filePath]);
         continue;
+      }
       error("Circular import detected");
     }
 
     visitedFiles[filePath] = false;
 
     imported = readFile(filePath);
-    handleFileImports(imported);
+    if (modules)
+      imported = importModule(filePath, imported);
+    else
+      handleFileImports(imported);
     program->merge(imported);
 
     visitedFiles[filePath] = true;
+    hash = ModuleCache::combine(hash, importHashes[filePath]);
   }
+  return hash;
+}
+
+// Imports of the module go first, its object depends on their declarations.
+// Importers see the interface of the module and of everything it imports.
+ProgramNode *ImportManager::importModule(fs::path path, ProgramNode *program) {
+  uint64_t source = ModuleCache::hashFile(path);
+  uint64_t interface = source;
+  bool separate = path.extension() == ".gu";
+
+  if (separate) {
+    program = ModuleCache::declarations(program);
+    // Bodies of generics are part of it, the whole source is then
+    if (!ModuleInterface::fingerprint(program, interface))
+      interface = source;
+  }
+
+  auto imports = handleFileImports(program);
+  if (separate)
+    importedObjFiles.insert(
+        modules->build(path, ModuleCache::combine(source, imports)));
+  importHashes[path.string()] = ModuleCache::combine(interface, imports);
+  return program;
 }
 
 fs::path ImportManager::getPackagePath(std::string package) {
-  if (libFilesO.find(package) == libFilesO.end() ||
-      libFilesH.find(package) == libFilesH.end())
+  auto objPath = findLibFile("GU" + package + ".o");
+  auto declPath = findLibFile("GU" + package + ".guh");
+  if (objPath.empty() || declPath.empty())
     error("Package " + package +
           " was not found, make sure that the package exists and there are "
           "binary and declaration files for the package");
 
-  auto declPath = libFilesH[package];
-  auto objPath = libFilesO[package];
-
   importedObjFiles.insert(objPath);
 
   auto stream = new std::ifstream(declPath);
@@ -105,7 +127,90 @@ fs::path ImportManager::getPackagePath(std::string package) {
   return declPath;
 }
 
+// Later paths take precedence, GU_LIB_PATH overrides the default ones
+fs::path ImportManager::findLibFile(std::string filename) {
+  for (auto path = libPaths.rbegin(); path != libPaths.rend(); path++) {
+    bool found = indexPath.empty() ? fs::is_regular_file(*path / filename)
+                                   : indexedFiles(*path).count(filename);
+    if (found)
+      return *path / filename;
+  }
+  return fs::path();
+}
+
+// The GU files of a directory, listed again only when its mtime changes
+const std::set<std::string> &ImportManager::indexedFiles(fs::path path) {
+  std::error_code ec;
+  auto mtime = fs::last_write_time(path, ec).time_since_epoch().count();
+  auto &entry = index[path.string()];
+  if (!ec && entry.first == mtime)
+    return entry.second;
+
+  entry.first = mtime;
+  entry.second.clear();
+  for (auto &file : fs::directory_iterator(path, ec)) {
+    auto filename = file.path().filename().string();
+    auto extension = file.path().extension().string();
+    if (filename.substr(0, 2) == "GU" &&
+        (extension == ".o" || extension == ".guh") && file.is_regular_file())
+      entry.second.insert(filename);
+  }
+  indexChanged = true;
+  return entry.second;
+}
+
+/*
+  One line per directory: the path, its mtime and the GU files in it, tab
+  separated. A broken or missing index is rebuilt as it is used.
+*/
+void ImportManager::loadIndex() {
+  std::ifstream stream(indexPath);
+  std::string line;
+  while (std::getline(stream, line)) {
+    std::vector<std::string> fields;
+    ulint start = 0;
+    for (ulint end; (end = line.find('\t', start)) != std::string::npos;
+         start = end + 1)
+      fields.push_back(line.substr(start, end - start));
+    fields.push_back(line.substr(start));
+    if (fields.size() < 2)
+      continue;
+
+    auto &entry = index[fields[0]];
+    entry.first = std::strtoll(fields[1].c_str(), nullptr, 10);
+    entry.second.insert(fields.begin() + 2, fields.end());
+  }
+}
+
+void ImportManager::saveIndex() {
+  std::error_code ec;
+  fs::create_directories(indexPath.parent_path(), ec);
+  auto tmpPath = indexPath.string() + ModuleCache::tmpSuffix();
+  std::ofstream stream(tmpPath);
+  if (!stream.is_open())
+    return;
+
+  for (auto &[path, entry] : index) {
+    stream << path << '\t' << entry.first;
+    for (auto &filename : entry.second)
+      stream << '\t' << filename;
+    stream << '\n';
+  }
+  stream.close();
+
+  // Replaced at once, concurrent compilations never read half an index
+  fs::rename(tmpPath, indexPath, ec);
+}
+
 ProgramNode *ImportManager::readFile(fs::path path) {
+  sourceFiles.insert(path);
+  if (path.extension() == ".guh") {
+    auto interface =
+        ModuleInterface::read(fs::path(path).replace_extension(".gpi"), path);
+    if (interface)
+      return interface;
+  }
+
   auto lexer = Lexer::fromFile(path.string());
   AstParser parser(lexer);
   auto program = parser.parseProgram();
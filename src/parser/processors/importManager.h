@@ -2,7 +2,9 @@
 #define _importManager
 
 #include "../parser.h"
+#include "interface.h"
 #include "libcDefiner.h"
+#include "moduleCache.h"
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
@@ -13,26 +15,40 @@
 
 class ImportManager {
 public:
-  ImportManager();
+  ImportManager(ModuleCache *modules = nullptr);
 
   void processImports(ProgramNode *program);
 
   const std::set<std::string> getImportedFiles() {
     return this->importedObjFiles;
   }
+  const std::set<std::string> &getSourceFiles() { return this->sourceFiles; }
 
 private:
   LibCDefiner libcDefiner;
-
-  std::map<std::string, std::filesystem::path> libFilesO;
-  std::map<std::string, std::filesystem::path> libFilesH;
+  // Compiles the .gu imports apart when set
+  ModuleCache *modules;
+  // What importers see of each imported file, with its own imports
+  std::map<std::string, uint64_t> importHashes;
+
+  std::vector<std::filesystem::path> libPaths;
+  // Directory listings by path with their mtime, when GU_LIB_INDEX is set
+  std::filesystem::path indexPath;
+  std::map<std::string, std::pair<long long, std::set<std::string>>> index;
+  bool indexChanged = false;
   std::map<std::string, bool> visitedFiles;
   std::set<std::string> importedObjFiles;
+  std::set<std::string> sourceFiles;
 
-  void handleFileImports(ProgramNode *program);
+  uint64_t handleFileImports(ProgramNode *program);
+  ProgramNode *importModule(std::filesystem::path path, ProgramNode *program);
   std::vector<std::string> &getObjectFiles();
   ProgramNode *readFile(std::filesystem::path path);
   std::filesystem::path getPackagePath(std::string package);
+  std::filesystem::path findLibFile(std::string filename);
+  const std::set<std::string> &indexedFiles(std::filesystem::path path);
+  void loadIndex();
+  void saveIndex();
 
   void error(std::string mst);
 };
@@ -0,0 +1,551 @@
+#include "interface.h"
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+const char INTERFACE_MAGIC[4] = {'G', 'U', 'P', 'I'};
+const uint32_t INTERFACE_VERSION = 1;
+
+enum class InterfaceTag : uint8_t {
+  FUNCTION,
+  STRUCT,
+  VAR,
+  NAMED_TYPE,
+  POINTER_TYPE,
+  ARRAY_TYPE,
+};
+
+// The whole file mapped read only, null when it can not be read
+static const char *mapFile(fs::path path, size_t &size) {
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat fileStat;
+  if (fd < 0 || fstat(fd, &fileStat) < 0 || fileStat.st_size == 0) {
+    if (fd >= 0)
+      close(fd);
+    return nullptr;
+  }
+
+  size = fileStat.st_size;
+  void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  return mapping == MAP_FAILED ? nullptr : (const char *)mapping;
+}
+
+// FNV-1a, the source only has to be told apart from its older versions
+static uint64_t hashOf(const char *data, size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; i++)
+    hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+  return hash;
+}
+
+static bool hashFile(fs::path path, uint64_t &hash) {
+  size_t size = 0;
+  auto data = mapFile(path, size);
+  if (!data)
+    return false;
+  hash = hashOf(data, size);
+  munmap((void *)data, size);
+  return true;
+}
+
+class InterfaceWriter {
+public:
+  std::string out;
+  std::string error;
+  // Every name is written once, nodes refer to it by index
+  std::vector<std::string> strings;
+  std::unordered_map<std::string, uint64_t> stringIds;
+  int64_t line = 0;
+  // Fingerprints leave them out, moving a declaration does not change it
+  bool locations = true;
+
+  // Numbers as LEB128 varints, most of them take a byte
+  void put(uint64_t value) {
+    do {
+      uint8_t byte = value & 0x7f;
+      value >>= 7;
+      out.push_back(value ? byte | 0x80 : byte);
+    } while (value);
+  }
+
+  void put(InterfaceTag tag) { put((uint64_t)tag); }
+
+  void putString(const std::string &str) {
+    auto found = stringIds.find(str);
+    if (found == stringIds.end()) {
+      found = stringIds.emplace(str, strings.size()).first;
+      strings.push_back(str);
+    }
+    put(found->second);
+  }
+
+  // Lines relative to the previous node, zigzag encoded as they may go back
+  void putLoc(SourceLoc loc) {
+    if (!locations)
+      return;
+    int64_t delta = (int64_t)loc.getLine() - line;
+    line = loc.getLine();
+    put(delta < 0 ? (uint64_t)(-delta) * 2 - 1 : (uint64_t)delta * 2);
+    put(loc.getCol());
+  }
+
+  bool writeDecl(AstNode *node) {
+    switch (node->getNodeType()) {
+    case NodeType::FUNCTION:
+      put(InterfaceTag::FUNCTION);
+      return writeFunction((FunctionNode *)node);
+    case NodeType::STRUCT_DEF:
+      put(InterfaceTag::STRUCT);
+      return writeStruct((StructDefNode *)node);
+    case NodeType::VAR_DEF:
+      put(InterfaceTag::VAR);
+      return writeVar((VarDefNode *)node);
+    default:
+      return fail("Unexpected declaration", node);
+    }
+  }
+
+  bool writeFunction(FunctionNode *node) {
+    if (node->_body || !node->_genericArgNames.empty())
+      return fail("Functions with a body can not be precompiled", node);
+
+    putLoc(node->_loc);
+    putString(node->_name.str());
+    putString(node->_externName);
+    put(node->_export | node->_external << 1 | node->_constant << 2 |
+                 node->_hot << 3);
+
+    put(node->_params.size());
+    for (auto param : node->_params)
+      if (!writeVar(param))
+        return false;
+    return writeType(node->_retTypeDef);
+  }
+
+  bool writeStruct(StructDefNode *node) {
+    if (!node->_genericArgNames.empty())
+      return fail("Struct templates can not be precompiled", node);
+
+    putLoc(node->_loc);
+    putString(node->_name.str());
+    put(node->_export | node->_external << 1);
+
+    put(node->_members.size());
+    for (auto member : node->_members)
+      if (!writeDecl(member))
+        return false;
+    return true;
+  }
+
+  bool writeVar(VarDefNode *node) {
+    if (!node->_initArgs.empty())
+      return fail("Init args can not be precompiled", node);
+
+    putLoc(node->_loc);
+    putString(node->_name.str());
+    auto value = (ExprConstantNode *)node->_defaultVal;
+    put(node->_export | node->_external << 1 | node->_constant << 2 |
+        (value != nullptr) << 3);
+    if (!writeType(node->_typeDef))
+      return false;
+    if (!value)
+      return true;
+    if (value->getNodeType() != NodeType::EXPR_CONSTANT)
+      return fail("Only constant defaults can be precompiled", node);
+
+    putLoc(value->_loc);
+    putString(value->_rawValue);
+    put(value->_rawType);
+    put(value->_intValue);
+    put(value->_isFloat);
+    put(value->elements.size());
+    for (auto element : value->elements)
+      put(element);
+    return true;
+  }
+
+  bool writeType(TypeDefNode *node) {
+    if (node->_pointsTo) {
+      put(InterfaceTag::POINTER_TYPE);
+      putLoc(node->_loc);
+      return writeType(node->_pointsTo);
+    }
+
+    if (node->_arrayOf) {
+      put(InterfaceTag::ARRAY_TYPE);
+      putLoc(node->_loc);
+      put(node->_arrSize);
+      putString(node->_arrSizeParam.str());
+      return writeType(node->_arrayOf);
+    }
+
+    put(InterfaceTag::NAMED_TYPE);
+    putLoc(node->_loc);
+    putString(node->_rawIdent.str());
+    put(node->_valueArg | !node->_genericArgsDefs.empty() << 1);
+    if (node->_valueArg)
+      put(node->_value);
+    if (node->_genericArgsDefs.empty())
+      return true;
+    put(node->_genericArgsDefs.size());
+    for (auto arg : node->_genericArgsDefs)
+      if (!writeType(arg))
+        return false;
+    return true;
+  }
+
+  bool fail(std::string msg, AstNode *node) {
+    error = node->_loc.str() + " " + msg;
+    return false;
+  }
+};
+
+/*
+  Rebuilds the nodes the way the parser links them, every node is a child
+  of the one it was read for. Any read past the end leaves ok false and the
+  nodes read so far are dropped with the arena.
+*/
+class InterfaceReader {
+public:
+  InterfaceReader(const char *data, size_t size, FileId file)
+      : data(data), size(size), file(file) {}
+
+  bool ok = true;
+
+  uint64_t get() {
+    uint64_t value = 0;
+    for (int shift = 0; ok; shift += 7) {
+      if (pos == size || shift > 63) {
+        ok = false;
+        return 0;
+      }
+      uint8_t byte = data[pos++];
+      value |= (uint64_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return value;
+    }
+    return 0;
+  }
+
+  InterfaceTag getTag() { return (InterfaceTag)get(); }
+
+  // The table of names, interned once for every node using them
+  void readStrings() {
+    for (auto count = getCount(); ok && count; count--) {
+      auto length = get();
+      if (!ok || size - pos < length) {
+        ok = false;
+        return;
+      }
+      strings.emplace_back(data + pos, length);
+      symbols.emplace_back(strings.back());
+      pos += length;
+    }
+  }
+
+  Symbol getSymbol() {
+    auto index = get();
+    if (index >= symbols.size()) {
+      ok = false;
+      return Symbol();
+    }
+    return symbols[index];
+  }
+
+  std::string getString() {
+    auto index = get();
+    if (index >= strings.size()) {
+      ok = false;
+      return "";
+    }
+    return std::string(strings[index]);
+  }
+
+  // Counts are checked against the bytes left, a corrupt one can not make
+  // the loops below run away
+  uint64_t getCount() {
+    auto count = get();
+    if (count > size - pos)
+      ok = false;
+    return ok ? count : 0;
+  }
+
+  SourceLoc getLoc() {
+    auto delta = get();
+    line += delta & 1 ? -(int64_t)((delta + 1) / 2) : (int64_t)(delta / 2);
+    auto col = get();
+    return SourceLoc(file, line, col);
+  }
+
+  ProgramNode *readProgram() {
+    auto program = new ProgramNode(SourceLoc(file, 0, 0));
+    readStrings();
+    for (auto count = getCount(); ok && count; count--) {
+      auto name = getString();
+      bool raw = get();
+      program->imports.push_back({name, raw});
+    }
+
+    for (auto count = getCount(); ok && count; count--)
+      readDecl(program);
+    return ok && pos == size ? program : nullptr;
+  }
+
+  AstNode *readDecl(AstNode *parent) {
+    switch (getTag()) {
+    case InterfaceTag::FUNCTION:
+      return readFunction(parent);
+    case InterfaceTag::STRUCT:
+      return readStruct(parent);
+    case InterfaceTag::VAR:
+      return readVar(parent);
+    default:
+      ok = false;
+      return nullptr;
+    }
+  }
+
+  FunctionNode *readFunction(AstNode *parent) {
+    auto loc = getLoc();
+    auto node = new FunctionNode(loc, parent, getSymbol());
+    node->_externName = getString();
+    auto flags = get();
+    node->_export = flags & 1;
+    node->_external = flags & 2;
+    node->_constant = flags & 4;
+    node->_hot = flags & 8;
+
+    for (auto count = getCount(); ok && count; count--)
+      node->_params.push_back(readVar(node));
+    node->_retTypeDef = readType(node);
+    return node;
+  }
+
+  StructDefNode *readStruct(AstNode *parent) {
+    auto loc = getLoc();
+    auto node = new StructDefNode(loc, parent, getSymbol());
+    auto flags = get();
+    node->_export = flags & 1;
+    node->_external = flags & 2;
+
+    for (auto count = getCount(); ok && count; count--) {
+      auto member = readDecl(node);
+      if (member)
+        node->_members.push_back(member);
+    }
+    return node;
+  }
+
+  VarDefNode *readVar(AstNode *parent) {
+    auto loc = getLoc();
+    auto name = getSymbol();
+    auto flags = get();
+    auto node = new VarDefNode(loc, parent, name, flags & 4);
+    node->_export = flags & 1;
+    node->_external = flags & 2;
+    node->_typeDef = readType(node);
+
+    if (!(flags & 8))
+      return node;
+
+    auto valueLoc = getLoc();
+    auto rawValue = getString();
+    auto rawType = get();
+    auto value = new ExprConstantNode(valueLoc, node, rawValue, rawType,
+                                      get());
+    value->_isFloat = get();
+    for (auto count = getCount(); ok && count; count--)
+      value->elements.push_back(get());
+    node->_defaultVal = value;
+    return node;
+  }
+
+  TypeDefNode *readType(AstNode *parent) {
+    TypeDefNode *node = nullptr;
+    auto tag = getTag();
+    auto loc = getLoc();
+
+    switch (tag) {
+    case InterfaceTag::POINTER_TYPE: {
+      auto inner = readType(nullptr);
+      if (!inner)
+        return nullptr;
+      node = TypeDefNode::buildPointer(inner, loc);
+      break;
+    }
+    case InterfaceTag::ARRAY_TYPE: {
+      auto arrSize = get();
+      auto arrSizeParam = getSymbol();
+      auto inner = readType(nullptr);
+      if (!inner)
+        return nullptr;
+      node = TypeDefNode::buildArray(inner, arrSize, loc);
+      node->_arrSizeParam = arrSizeParam;
+      break;
+    }
+    case InterfaceTag::NAMED_TYPE: {
+      node = TypeDefNode::build(getSymbol(), loc);
+      auto flags = get();
+      node->_valueArg = flags & 1;
+      if (node->_valueArg)
+        node->_value = get();
+      if (!(flags & 2))
+        break;
+      for (auto count = getCount(); ok && count; count--)
+        node->_genericArgsDefs.push_back(readType(node));
+      break;
+    }
+    default:
+      ok = false;
+      return nullptr;
+    }
+
+    if (parent) {
+      node->_parent = parent;
+      parent->_children.push_back(node);
+    }
+    return ok ? node : nullptr;
+  }
+
+private:
+  const char *data;
+  size_t size;
+  size_t pos = 0;
+  FileId file;
+  std::vector<std::string_view> strings;
+  std::vector<Symbol> symbols;
+  int64_t line = 0;
+};
+
+bool ModuleInterface::fingerprint(ProgramNode *program, uint64_t &hash) {
+  InterfaceWriter writer;
+  writer.locations = false;
+  for (auto &[name, raw] : program->imports) {
+    writer.putString(name);
+    writer.put(raw);
+  }
+  for (auto child : program->_children)
+    if (!writer.writeDecl(child))
+      return false;
+
+  for (auto &str : writer.strings) {
+    writer.put(str.size());
+    writer.out += str;
+  }
+  hash = hashOf(writer.out.data(), writer.out.size());
+  return true;
+}
+
+bool ModuleInterface::write(ProgramNode *program, fs::path sourcePath,
+                            fs::path path, std::string &error) {
+  uint64_t hash;
+  if (!hashFile(sourcePath, hash)) {
+    error = "Was not possible to read " + sourcePath.string();
+    return false;
+  }
+
+  InterfaceWriter writer;
+  writer.put(program->imports.size());
+  for (auto &[name, raw] : program->imports) {
+    writer.putString(name);
+    writer.put(raw);
+  }
+
+  writer.put(program->_children.size());
+  for (auto child : program->_children) {
+    if (!writer.writeDecl(child)) {
+      error = writer.error;
+      return false;
+    }
+  }
+
+  // The names go before the nodes, the reader interns them first
+  InterfaceWriter header;
+  header.out.append(INTERFACE_MAGIC, sizeof INTERFACE_MAGIC);
+  header.put(INTERFACE_VERSION);
+  header.put(hash);
+  header.put(writer.strings.size());
+  for (auto &str : writer.strings) {
+    header.put(str.size());
+    header.out += str;
+  }
+
+  // Written aside and renamed, a compilation never reads half an interface
+  auto tmpPath = path.string() + ".tmp";
+  std::ofstream stream(tmpPath, std::ios::binary);
+  stream.write(header.out.data(), header.out.size());
+  stream.write(writer.out.data(), writer.out.size());
+  stream.close();
+
+  std::error_code ec;
+  if (!stream || (fs::rename(tmpPath, path, ec), ec)) {
+    error = "Was not possible to write " + path.string();
+    return false;
+  }
+  return true;
+}
+
+// Interfaces checked against their source stay mapped for the rest of the
+// process, the jobs of a batch decode their own nodes from the same pages
+struct MappedInterface {
+  const char *data = nullptr;
+  size_t size = 0;
+  FileId file = 0;
+};
+
+static std::mutex mappedMutex;
+static std::map<std::string, MappedInterface> mappedInterfaces;
+
+static MappedInterface mapInterface(fs::path path, fs::path sourcePath) {
+  std::lock_guard<std::mutex> lock(mappedMutex);
+  auto found = mappedInterfaces.find(path.string());
+  if (found != mappedInterfaces.end())
+    return found->second;
+
+  MappedInterface mapped;
+  mapped.data = mapFile(path, mapped.size);
+  uint64_t sourceHash;
+  bool valid = mapped.data && mapped.size >= sizeof INTERFACE_MAGIC &&
+               !std::memcmp(mapped.data, INTERFACE_MAGIC,
+                            sizeof INTERFACE_MAGIC) &&
+               hashFile(sourcePath, sourceHash);
+  if (valid) {
+    InterfaceReader reader(mapped.data + sizeof INTERFACE_MAGIC,
+                           mapped.size - sizeof INTERFACE_MAGIC, 0);
+    valid = reader.get() == INTERFACE_VERSION && reader.get() == sourceHash;
+  }
+
+  if (!valid) {
+    if (mapped.data)
+      munmap((void *)mapped.data, mapped.size);
+    mapped = MappedInterface();
+  } else {
+    // Diagnostics point to the source, as if it had been parsed
+    mapped.file = FileTable::global().add(fs::canonical(sourcePath).string());
+  }
+  return mappedInterfaces[path.string()] = mapped;
+}
+
+ProgramNode *ModuleInterface::read(fs::path path, fs::path sourcePath) {
+  auto mapped = mapInterface(path, sourcePath);
+  if (!mapped.data)
+    return nullptr;
+
+  InterfaceReader reader(mapped.data + sizeof INTERFACE_MAGIC,
+                         mapped.size - sizeof INTERFACE_MAGIC, mapped.file);
+  // Version and source hash, already checked
+  reader.get();
+  reader.get();
+  return reader.readProgram();
+}
@@ -0,0 +1,30 @@
+#ifndef _interface
+#define _interface
+
+#include "../../ast/ast.h"
+#include <filesystem>
+#include <string>
+
+/*
+  Precompiled form of a declaration file, GUbase.gpi next to GUbase.guh.
+  After a magic, the format version and a hash of the .guh it came from, it
+  holds a table with every name and then the imports and the top level
+  declarations as they were parsed, in preorder. Numbers are varints and
+  names indexes in the table. Only declarations without bodies are written,
+  the defaults of globals have to be constants.
+*/
+class ModuleInterface {
+public:
+  // False with the reason in error when some declaration can not be written
+  static bool write(ProgramNode *program, std::filesystem::path sourcePath,
+                    std::filesystem::path path, std::string &error);
+  // Hash of the declarations without their locations, false when some of
+  // them can not be written
+  static bool fingerprint(ProgramNode *program, uint64_t &hash);
+  // Null when there is no interface or it is from another version of the
+  // format or of the source, the caller parses the source then
+  static ProgramNode *read(std::filesystem::path path,
+                           std::filesystem::path sourcePath);
+};
+
+#endif
@@ -187,8 +187,7 @@ void LibCDefiner::addPosixSyscallsDefs(ProgramNode *node) {
 FunctionNode *LibCDefiner::buildFunc(std::string &name,
                                      std::vector<VarDefNode *> &params,
                                      DataType *retType, AstNode *parent) {
-  std::string filename = "";
-  auto node = new FunctionNode(filename, 0, 0, nullptr, name);
+  auto node = new FunctionNode(SourceLoc(), nullptr, name);
   for (auto param : params) {
     node->_params.push_back(param);
     param->_parent = node;
@@ -199,8 +198,7 @@ FunctionNode *LibCDefiner::buildFunc(std::string &name,
 }
 
 VarDefNode *LibCDefiner::buildParam(std::string name, DataType *type) {
-  std::string filename = "";
-  auto node = new VarDefNode(filename, 0, 0, nullptr, name);
+  auto node = new VarDefNode(SourceLoc(), nullptr, name);
   node->type = type;
   return node;
 }
\ No newline at end of file
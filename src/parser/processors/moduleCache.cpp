@@ -0,0 +1,162 @@
+#include "moduleCache.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace fs = std::filesystem;
+
+const char *GU_CACHE_ENV_VAR = "GU_CACHE_DIR";
+
+std::string ModuleCache::toHex(uint64_t value) {
+  char buffer[17];
+  std::snprintf(buffer, sizeof buffer, "%016llx", (unsigned long long)value);
+  return buffer;
+}
+
+uint64_t ModuleCache::hashString(const std::string &data) {
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : data)
+    hash = (hash ^ c) * 1099511628211ull;
+  return hash;
+}
+
+ModuleCache::ModuleCache(char optLevel, bool sharedGenerics) {
+  flags = {"-O", std::string(1, optLevel)};
+  if (sharedGenerics)
+    flags.push_back("-G");
+
+  std::error_code ec;
+  compiler = fs::read_symlink("/proc/self/exe", ec);
+  if (ec)
+    error("Was not possible to find the compiler binary");
+  std::string flagsText;
+  for (auto &flag : flags)
+    flagsText += " " + flag;
+  identity = combine(hashString(flagsText), compilerId());
+  dir = cacheDir() / "modules";
+}
+
+fs::path ModuleCache::cacheDir() {
+  auto cacheDir = std::getenv(GU_CACHE_ENV_VAR);
+  if (cacheDir && *cacheDir)
+    return cacheDir;
+  auto homePath = std::getenv("HOME");
+  return fs::path(homePath ? homePath : "/tmp") / ".cache/gu";
+}
+
+uint64_t ModuleCache::compilerId() {
+  std::error_code ec;
+  auto compiler = fs::read_symlink("/proc/self/exe", ec);
+  auto size = fs::file_size(compiler, ec);
+  auto mtime = fs::last_write_time(compiler, ec).time_since_epoch().count();
+  return combine(combine(hashString(""), size), mtime);
+}
+
+static void declareFunction(FunctionNode *func) {
+  func->_body = nullptr;
+  func->_innerVars.clear();
+  func->_external = true;
+}
+
+ProgramNode *ModuleCache::declarations(ProgramNode *program) {
+  for (auto child : program->_children) {
+    switch (child->getNodeType()) {
+    case NodeType::FUNCTION: {
+      auto func = (FunctionNode *)child;
+      if (!func->_constant && func->_genericArgNames.empty())
+        declareFunction(func);
+      break;
+    }
+    case NodeType::STRUCT_DEF: {
+      auto structDef = (StructDefNode *)child;
+      if (!structDef->_genericArgNames.empty())
+        break;
+      structDef->_external = true;
+      for (auto member : structDef->_members)
+        if (member->getNodeType() == NodeType::FUNCTION)
+          declareFunction((FunctionNode *)member);
+      break;
+    }
+    case NodeType::VAR_DEF: {
+      // Constants keep their value to be folded where they are used
+      auto var = (VarDefNode *)child;
+      var->_external = true;
+      var->_initArgs.clear();
+      if (!var->_constant)
+        var->_defaultVal = nullptr;
+      break;
+    }
+    default:
+      break;
+    }
+  }
+  return program;
+}
+
+uint64_t ModuleCache::hashFile(fs::path path) {
+  std::ifstream stream(path, std::ios::binary);
+  std::string content(std::istreambuf_iterator<char>(stream), {});
+  return hashString(content);
+}
+
+uint64_t ModuleCache::combine(uint64_t hash, uint64_t value) {
+  for (int i = 0; i < 8; i++, value >>= 8)
+    hash = (hash ^ (value & 0xff)) * 1099511628211ull;
+  return hash;
+}
+
+std::string ModuleCache::tmpSuffix() {
+  static std::atomic<unsigned> counter{0};
+  return "." + std::to_string(getpid()) + "." + std::to_string(counter++) +
+         ".tmp";
+}
+
+bool ModuleCache::spawn(const std::vector<std::string> &args) {
+  std::vector<char *> argv;
+  for (auto &arg : args)
+    argv.push_back((char *)arg.c_str());
+  argv.push_back(nullptr);
+
+  pid_t pid;
+  int status;
+  if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ))
+    return false;
+  if (waitpid(pid, &status, 0) < 0)
+    return false;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+fs::path ModuleCache::build(fs::path path, uint64_t inputs) {
+  // Symbols are mangled with the module name, equal sources elsewhere differ
+  auto module = combine(identity, hashString(fs::canonical(path).string()));
+  auto object = dir / (toHex(combine(module, inputs)) + ".o");
+  if (fs::is_regular_file(object))
+    return object;
+
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+
+  // Written aside and renamed, parallel builds never link half an object
+  auto tmpPath = object.string() + tmpSuffix();
+  std::vector<std::string> args = {compiler.string(), "-c", "-M"};
+  args.insert(args.end(), flags.begin(), flags.end());
+  args.insert(args.end(), {fs::canonical(path).string(), "-o", tmpPath});
+  if (!spawn(args) || (fs::rename(tmpPath, object, ec), ec)) {
+    fs::remove(tmpPath, ec);
+    error("Module " + path.string() + " could not be compiled");
+  }
+  return object;
+}
+
+void ModuleCache::error(std::string msg) {
+  std::cerr << "import error: " + msg << std::endl;
+  exit(1);
+}
@@ -0,0 +1,54 @@
+#ifndef _moduleCache
+#define _moduleCache
+
+#include "../../ast/ast.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/*
+  Objects of the .gu files imported by path, compiled one per module instead
+  of merged into the importer. They are kept in GU_CACHE_DIR (~/.cache/gu by
+  default) under a hash of its path and source, of the interfaces it imports,
+  of the flags and of the compiler, so a module is compiled again only when
+  one of those changes. Importers get its definitions as declarations, which the
+  assembler names as the module object does.
+*/
+class ModuleCache {
+public:
+  ModuleCache(char optLevel, bool sharedGenerics);
+
+  // What an importer needs of a module, generic and const functions keep
+  // their bodies as the importer expands them
+  static ProgramNode *declarations(ProgramNode *program);
+
+  // GU_CACHE_DIR, ~/.cache/gu by default
+  static std::filesystem::path cacheDir();
+  // Size and mtime of the compiler binary, a rebuilt compiler changes it
+  static uint64_t compilerId();
+  static uint64_t hashFile(std::filesystem::path path);
+  static uint64_t hashString(const std::string &data);
+  static std::string toHex(uint64_t value);
+  static uint64_t combine(uint64_t hash, uint64_t value);
+  // Ends the name of a file written aside, unique among the processes and
+  // threads writing the cache
+  static std::string tmpSuffix();
+  // Runs a program found in PATH without a shell, so the arguments reach it
+  // as they are. True when it exits with 0
+  static bool spawn(const std::vector<std::string> &args);
+
+  // Object of the module, compiled by another process unless it is cached
+  std::filesystem::path build(std::filesystem::path path, uint64_t inputs);
+
+private:
+  std::vector<std::string> flags;
+  std::filesystem::path compiler;
+  std::filesystem::path dir;
+  // Flags and compiler binary, any of them changes every object
+  uint64_t identity;
+
+  void error(std::string msg);
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "reachability.h"
+
+static Symbol nameOf(AstNode *node) {
+  switch (node->getNodeType()) {
+  case NodeType::FUNCTION:
+    return ((FunctionNode *)node)->_name;
+  case NodeType::STRUCT_DEF:
+    return ((StructDefNode *)node)->_name;
+  case NodeType::VAR_DEF:
+    return ((VarDefNode *)node)->_name;
+  default:
+    return Symbol();
+  }
+}
+
+static bool isExternal(AstNode *node) {
+  switch (node->getNodeType()) {
+  case NodeType::FUNCTION:
+    return ((FunctionNode *)node)->_external;
+  case NodeType::STRUCT_DEF:
+    return ((StructDefNode *)node)->_external;
+  case NodeType::VAR_DEF:
+    return ((VarDefNode *)node)->_external;
+  default:
+    return false;
+  }
+}
+
+static bool isExported(AstNode *node) {
+  switch (node->getNodeType()) {
+  case NodeType::FUNCTION:
+    return ((FunctionNode *)node)->_export;
+  case NodeType::STRUCT_DEF:
+    return ((StructDefNode *)node)->_export;
+  case NodeType::VAR_DEF:
+    return ((VarDefNode *)node)->_export;
+  default:
+    return false;
+  }
+}
+
+void Reachability::visitProgram(ProgramNode *node) {
+  for (auto child : node->_children)
+    declared[nameOf(child)].push_back(child);
+
+  // Used without being spelled, by the entrypoint and by init args
+  reachMember(INIT_FUNC);
+  if (fromMain) {
+    reach(MAIN_FUNC);
+    reach("sys_exit");
+  }
+
+  // What the compiled file defines is always validated, even if unused
+  auto file = node->_loc.getFile();
+  for (auto child : node->_children) {
+    bool own = child->_loc.getFile() == file;
+    if (!own && !isExported(child) && (fromMain || isExternal(child)))
+      continue;
+
+    push(child);
+    // Other objects may call any method of the structs defined here
+    if (child->getNodeType() == NodeType::STRUCT_DEF)
+      for (auto member : ((StructDefNode *)child)->_members)
+        if (member->getNodeType() == NodeType::FUNCTION)
+          push(member);
+  }
+
+  while (!pending.empty()) {
+    auto next = pending.back();
+    pending.pop_back();
+    visit(next);
+  }
+
+  std::vector<AstNode *> children;
+  for (auto child : node->_children) {
+    if (!reached.count(child))
+      continue;
+    children.push_back(child);
+
+    if (child->getNodeType() != NodeType::STRUCT_DEF)
+      continue;
+    auto &structMembers = ((StructDefNode *)child)->_members;
+    std::vector<AstNode *> kept;
+    for (auto member : structMembers)
+      if (member->getNodeType() != NodeType::FUNCTION || reached.count(member))
+        kept.push_back(member);
+    structMembers = std::move(kept);
+  }
+  node->_children = std::move(children);
+}
+
+// Fields are needed for the layout, methods only once their name is used
+void Reachability::visitStructDef(StructDefNode *node) {
+  if (!node->_genericArgNames.empty())
+    return;
+
+  for (auto member : node->_members) {
+    if (member->getNodeType() != NodeType::FUNCTION) {
+      visit(member);
+      continue;
+    }
+
+    auto method = (FunctionNode *)member;
+    if (members.contains(method->_name))
+      push(method);
+    else
+      methods[method->_name].push_back(method);
+  }
+}
+
+void Reachability::visitTypeDefNode(TypeDefNode *node) {
+  reach(node->_rawIdent);
+  visitChildren(node);
+}
+
+void Reachability::visitMemberAccess(ExprMemberAccess *node) {
+  reachMember(node->_memberName);
+  visitChildren(node);
+}
+
+void Reachability::reach(Symbol name) {
+  if (names.contains(name))
+    return;
+  names[name] = true;
+
+  auto found = declared.find(name);
+  if (found != declared.end())
+    for (auto decl : found->second)
+      push(decl);
+}
+
+void Reachability::reachMember(Symbol name) {
+  if (members.contains(name))
+    return;
+  members[name] = true;
+
+  auto found = methods.find(name);
+  if (found != methods.end())
+    for (auto method : found->second)
+      push(method);
+}
+
+void Reachability::push(AstNode *node) {
+  if (reached.insert(node).second)
+    pending.push_back(node);
+}
@@ -0,0 +1,57 @@
+#ifndef _reachability
+#define _reachability
+
+#include "../../ast/ast.h"
+#include "../../ast/visitor.h"
+#include <unordered_set>
+#include <vector>
+
+/*
+  Drops the imported declarations the program can not reach before they are
+  validated or emitted. Names are followed from main and from everything the
+  compiled file defines, or from every definition when compiling without an
+  entrypoint, so the syscalls and the imported declarations cost nothing
+  unless they are used. Methods are kept when some member access spells their
+  name. Names are matched without scopes, a local shadowing a global keeps
+  the global alive.
+*/
+class Reachability : public StaticVisitor<Reachability> {
+public:
+  Reachability(bool fromMain) { this->fromMain = fromMain; }
+
+  void visitProgram(ProgramNode *node);
+  void visitFunction(FunctionNode *node) { visitChildren(node); }
+  void visitStructDef(StructDefNode *node);
+  void visitBody(BodyNode *node) { visitChildren(node); }
+  void visitIf(IfNode *node) { visitChildren(node); }
+  void visitWhile(WhileNode *node) { visitChildren(node); }
+  void visitFor(ForNode *node) { visitChildren(node); }
+  void visitVarDef(VarDefNode *node) { visitChildren(node); }
+  void visitTypeDefNode(TypeDefNode *node);
+  void visitReturnNode(ReturnNode *node) { visitChildren(node); }
+
+  void visitExprBinaryOp(ExprBinaryNode *node) { visitChildren(node); }
+  void visitMemberAccess(ExprMemberAccess *node);
+  void visitIndexAccess(ExprIndex *node) { visitChildren(node); }
+  void visitExprCall(ExprCallNode *node) { visitChildren(node); }
+  void visitExprUnaryOp(ExprUnaryNode *node) { visitChildren(node); }
+  void visitExprVarRef(ExprVarRefNode *node) { reach(node->_ident); }
+
+private:
+  bool fromMain;
+
+  SymbolMap<std::vector<AstNode *>> declared;
+  // Methods of reached structs waiting for a member access with their name
+  SymbolMap<std::vector<FunctionNode *>> methods;
+  SymbolMap<bool> names;
+  SymbolMap<bool> members;
+
+  std::unordered_set<AstNode *> reached;
+  std::vector<AstNode *> pending;
+
+  void reach(Symbol name);
+  void reachMember(Symbol name);
+  void push(AstNode *node);
+};
+
+#endif
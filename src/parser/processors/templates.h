@@ -2,9 +2,11 @@
 #define _generics
 
 #include "astCloner.h"
-#include <random>
+#include <algorithm>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 class TemplatesVisitor : public BaseVisitor {
 public:
@@ -12,77 +14,68 @@ public:
 
   void visitTypeDefNode(TypeDefNode *node) override {
     node->visitChildren(this);
-    if (node->_genericArgsDefs.empty())
-      return;
-
-    StructDefNode *_struct;
-    ulint _iStruct;
-
-    for (ulint i = 0; i < program->_children.size(); i++) {
-      auto child = program->_children[i];
-      if (child->getNodeType() != NodeType::STRUCT_DEF)
-        continue;
-      auto structChild = (StructDefNode *)child;
-      if (node->_rawIdent != structChild->_name)
-        continue;
+    if (node->_genericArgsDefs.empty()) {
+      auto _struct = templates.lookup(node->_rawIdent);
+      if (!_struct || _struct->_genericArgNames.empty())
+        return;
+    }
 
-      _struct = structChild;
-      _iStruct = i;
-      break;
+    // Arguments first, Box<Box<int>> needs Box<int> to be declared before it
+    auto genericArgs = std::move(node->_genericArgsDefs);
+    node->_genericArgsDefs.clear();
+    for (auto arg : genericArgs) {
+      if (function && names(arg, function->_genericArgNames))
+        error("Generic function " + function->_name.str() +
+              " can not instantiate " + node->_rawIdent.str() +
+              " with its own type parameters");
+      arg->visit(this);
     }
 
+    auto _struct = templates.lookup(node->_rawIdent);
     if (!_struct)
-      error("Type " + node->_rawIdent + " does not exists.");
-
-    auto structGenericParams = _struct->_genericArgNames;
-
-    if (structGenericParams.size() != node->_genericArgsDefs.size())
-      error("Invalid template argument size for struct " + node->_rawIdent +
-            " expecting " + std::to_string(structGenericParams.size()));
-
-    auto implHash =
-        _struct->_name + "-" + generateArgsHash(node->_genericArgsDefs);
-    if (implementationMap.find(implHash) != implementationMap.end()) {
-      auto structName = implementationMap[implHash];
-      StructDefNode *structDef = nullptr;
-
-      for (auto node : program->_children) {
-        if (node->getNodeType() != NodeType::STRUCT_DEF)
-          continue;
-        auto _struct = (StructDefNode *)node;
-        if (_struct->_name != structName)
-          continue;
-        structDef = _struct;
-        break;
-      }
-
-      node->_rawIdent = structDef->_name;
-      return;
-    }
+      error("Type " + node->_rawIdent.str() + " does not exists.");
+
+    auto &structGenericParams = _struct->_genericArgNames;
 
-    auto prefix = generateHash();
-    astCloner->setPrefix(prefix);
+    // Trailing integer parameters left out take their default, Buf is
+    // Buf<512>
+    auto &defaults = _struct->_genericArgDefaults;
+    while (genericArgs.size() < defaults.size() && defaults[genericArgs.size()])
+      genericArgs.push_back(defaults[genericArgs.size()]);
+
+    if (structGenericParams.size() != genericArgs.size())
+      error("Invalid template argument size for struct " +
+            node->_rawIdent.str() + " expecting " +
+            std::to_string(structGenericParams.size()));
 
     for (ulint i = 0; i < structGenericParams.size(); i++)
-      astCloner->setUpdateType(structGenericParams[i],
-                               node->_genericArgsDefs[i]);
+      checkArg(_struct, i, genericArgs[i]);
+
+    // The arguments are spelled in the name of the instance from now on
+    auto &children = node->_children;
+    for (auto arg : genericArgs)
+      children.erase(std::remove(children.begin(), children.end(), arg),
+                     children.end());
+
+    Symbol implName = mangle(_struct->_name, genericArgs);
+    node->_rawIdent = implName;
+    if (implementations.contains(implName))
+      return;
+
+    astCloner->clearUpdates();
+    for (ulint i = 0; i < structGenericParams.size(); i++)
+      astCloner->setUpdateType(structGenericParams[i], genericArgs[i]);
 
     astCloner->visitStructDef(_struct);
     auto clonedStruct = (StructDefNode *)astCloner->getCloned();
+    clonedStruct->_name = implName;
+    clonedStruct->_genericOf = _struct;
     clonedStruct->_parent = program;
-    ulint index = program->_children.size();
-    program->_children.push_back(clonedStruct);
-    while (--index > _iStruct) {
-      auto temp = program->_children[index];
-      program->_children[index] = program->_children[index + 1];
-      program->_children[index + 1] = temp;
-    }
-
-    implementationMap[implHash] = clonedStruct->_name;
-    node->_rawIdent = clonedStruct->_name;
-    node->_genericArgsDefs.clear();
+    implementations[implName] = clonedStruct;
 
+    // Appended after the instances it needs, which are created visiting it
     clonedStruct->visit(this);
+    instances[user].push_back(clonedStruct);
   };
 
   void visitStructDef(StructDefNode *node) override {
@@ -96,11 +89,40 @@ public:
     astCloner->clearPrefix();
     astCloner->clearUpdates();
 
-    node->visitChildren(this);
+    for (auto child : node->_children) {
+      if (child->getNodeType() != NodeType::STRUCT_DEF)
+        continue;
+      auto structChild = (StructDefNode *)child;
+      if (!templates.contains(structChild->_name))
+        templates[structChild->_name] = structChild;
+    }
+
+    for (auto child : node->_children) {
+      user = child;
+      child->visit(this);
+    }
+
+    // Instances go right before the declaration that first used them, after
+    // every type their arguments name, spliced in a single pass
+    if (instances.empty())
+      return;
+
+    std::vector<AstNode *> children;
+    for (auto child : node->_children) {
+      auto found = instances.find(child);
+      if (found != instances.end())
+        children.insert(children.end(), found->second.begin(),
+                        found->second.end());
+      children.push_back(child);
+    }
+    node->_children = std::move(children);
   };
 
   void visitFunction(FunctionNode *node) override {
+    auto outer = function;
+    function = node;
     node->visitChildren(this);
+    function = outer;
   };
   void visitBody(BodyNode *node) override { node->visitChildren(this); };
   void visitIf(IfNode *node) override { node->visitChildren(this); };
@@ -123,6 +145,20 @@ public:
   };
   void visitExprCall(ExprCallNode *node) override {
     node->visitChildren(this);
+
+    // sizeof(Buf) names a template through the defaults of its parameters
+    auto ref = (ExprVarRefNode *)node->_ref;
+    if (ref->getNodeType() != NodeType::VAR_REF ||
+        ref->_ident != SIZEOF_FUNC || node->_args.size() != 1 ||
+        node->_args[0]->getNodeType() != NodeType::VAR_REF)
+      return;
+    auto arg = (ExprVarRefNode *)node->_args[0];
+    auto _struct = templates.lookup(arg->_ident);
+    if (!_struct || _struct->_genericArgNames.empty())
+      return;
+    auto typeDef = TypeDefNode::build(arg->_ident, arg->_loc);
+    visitTypeDefNode(typeDef);
+    arg->_ident = typeDef->_rawIdent;
   };
   void visitExprUnaryOp(ExprUnaryNode *node) override {
     node->visitChildren(this);
@@ -135,40 +171,73 @@ public:
 private:
   AstCloner *astCloner;
   ProgramNode *program;
-  std::map<std::string, std::string> implementationMap;
+  SymbolMap<StructDefNode *> templates;
+  // Keyed by the mangled name, which is the structural key of the instance
+  SymbolMap<StructDefNode *> implementations;
+  std::unordered_map<AstNode *, std::vector<StructDefNode *>> instances;
+  AstNode *user = nullptr;
+  FunctionNode *function = nullptr;
 
   void error(std::string msg) {
     std::cerr << "template usage error: " << msg << std::endl;
     exit(1);
   }
 
-  std::string generateArgsHash(std::vector<TypeDefNode *> &args) {
-    std::string hash = "";
-    for (auto arg : args) {
-      hash += generateTypeHash(arg);
-      hash += '-';
+  // Spelled the way the source does, Pair<*char,int[4]>, identifiers can not
+  // contain these characters so instances never clash with user structs
+  std::string mangle(Symbol name, std::vector<TypeDefNode *> &args) {
+    std::string mangled = name.str() + "<";
+    for (ulint i = 0; i < args.size(); i++) {
+      if (i)
+        mangled += ',';
+      mangled += typeName(args[i]);
     }
-    return hash;
+    return mangled + ">";
   }
 
-  std::string generateTypeHash(TypeDefNode *typeDef) {
+  // Integer parameters take a literal that fits their type, the rest a type
+  void checkArg(StructDefNode *_struct, ulint i, TypeDefNode *arg) {
+    auto paramType = _struct->_genericArgTypes[i];
+    auto param =
+        _struct->_name.str() + "." + _struct->_genericArgNames[i].str();
+
+    if (!paramType) {
+      if (arg->_valueArg)
+        error("Template parameter " + param + " expects a type, got " +
+              arg->_rawIdent.str());
+      return;
+    }
+
+    if (!arg->_valueArg)
+      error("Template parameter " + param + " expects an integer, got " +
+            typeName(arg));
+    auto type = DataType::build(paramType);
+    if (!DataType::isInt(type->raw))
+      error("Template parameter " + param + " must have an integer type");
+    if (arg->_value >> (type->size * 8 - 1))
+      error("Template argument " + arg->_rawIdent.str() + " does not fit in " +
+            typeName(paramType));
+  }
+
+  bool names(TypeDefNode *typeDef, std::vector<Symbol> &params) {
     if (typeDef->_pointsTo)
-      return "*" + generateTypeHash(typeDef->_pointsTo);
+      return names(typeDef->_pointsTo, params);
     if (typeDef->_arrayOf)
-      return "[]" + generateTypeHash(typeDef->_arrayOf);
-    return typeDef->_rawIdent;
+      return names(typeDef->_arrayOf, params);
+    for (auto arg : typeDef->_genericArgsDefs)
+      if (names(arg, params))
+        return true;
+    return std::find(params.begin(), params.end(), typeDef->_rawIdent) !=
+           params.end();
   }
 
-  std::string generateHash() {
-    std::string hash = "";
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0x61, 0x7a);
-
-    for (int i = 0; i < 20; i++)
-      hash += dis(gen);
-
-    return hash;
+  std::string typeName(TypeDefNode *typeDef) {
+    if (typeDef->_pointsTo)
+      return "*" + typeName(typeDef->_pointsTo);
+    if (typeDef->_arrayOf)
+      return typeName(typeDef->_arrayOf) + "[" +
+             std::to_string(typeDef->_arrSize) + "]";
+    return typeDef->_rawIdent.str();
   }
 };
 
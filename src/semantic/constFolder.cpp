@@ -0,0 +1,222 @@
+#include "constFolder.h"
+#include <cstring>
+
+void ConstFolder::visitProgram(ProgramNode *node) {
+  for (auto child : node->_children)
+    visit(child);
+}
+
+// Const functions are run by the interpreter, calls in them are not folded.
+// Generic functions are folded through their instances
+void ConstFolder::visitFunction(FunctionNode *node) {
+  if (node->_external || node->_constant || !node->_body ||
+      !node->_genericArgNames.empty())
+    return;
+  visit(node->_body);
+}
+
+void ConstFolder::visitStructDef(StructDefNode *node) {
+  if (!node->_genericArgNames.empty())
+    return;
+
+  for (auto member : node->_members)
+    if (member->getNodeType() == NodeType::FUNCTION)
+      visit(member);
+}
+
+void ConstFolder::visitBody(BodyNode *node) {
+  for (auto &statement : node->_statements) {
+    if (statement->isExpr())
+      statement = fold((ExprNode *)statement);
+    else
+      visit(statement);
+  }
+}
+
+void ConstFolder::visitVarDef(VarDefNode *node) {
+  for (auto &arg : node->_initArgs)
+    arg = fold(arg);
+
+  if (!node->_defaultVal)
+    return;
+  auto errorCount = errors.size();
+  node->_defaultVal = fold(node->_defaultVal);
+
+  // Globals need the initializer in the type of the variable
+  bool global =
+      node->_parent && node->_parent->getNodeType() == NodeType::PROGRAM;
+
+  if (global && node->_defaultVal->getNodeType() != NodeType::EXPR_CONSTANT &&
+      errors.size() == errorCount)
+    compile_error("Default value in global variable should be constant",
+                  node);
+
+  ConstValue value;
+  if ((!node->_constant && !global) || !node->type ||
+      !ConstValue::read(node->_defaultVal, value) ||
+      !value.convert(node->type))
+    return;
+
+  if (node->_defaultVal->type != node->type)
+    node->_defaultVal =
+        replace(node->_defaultVal, value.materialize(node->_loc));
+
+  if (node->_constant)
+    constValues[node] = (ExprConstantNode *)node->_defaultVal;
+}
+
+void ConstFolder::visitIf(IfNode *node) {
+  node->_expr = fold(node->_expr);
+  visit(node->_ifBody);
+  if (node->_elseBody)
+    visit(node->_elseBody);
+}
+
+void ConstFolder::visitWhile(WhileNode *node) {
+  node->_expr = fold(node->_expr);
+  visit(node->_body);
+}
+
+void ConstFolder::visitFor(ForNode *node) {
+  node->_start = fold(node->_start);
+  node->_cond = fold(node->_cond);
+  node->_inc = fold(node->_inc);
+  visit(node->_body);
+}
+
+void ConstFolder::visitReturnNode(ReturnNode *node) {
+  node->_expr = fold(node->_expr);
+}
+
+ExprNode *ConstFolder::fold(ExprNode *node) {
+  if (!node)
+    return node;
+
+  switch (node->getNodeType()) {
+  case NodeType::EXPR_BINARY:
+    return foldBinary((ExprBinaryNode *)node);
+  case NodeType::EXPR_UNARY:
+    return foldUnary((ExprUnaryNode *)node);
+  case NodeType::VAR_REF:
+    return foldVarRef((ExprVarRefNode *)node);
+  case NodeType::INDEX_ACCESS: {
+    auto index = (ExprIndex *)node;
+    index->_inner = fold(index->_inner);
+    index->_index = fold(index->_index);
+    return node;
+  }
+  case NodeType::MEMBER_ACCESS: {
+    auto member = (ExprMemberAccess *)node;
+    member->_struct = fold(member->_struct);
+    return node;
+  }
+  case NodeType::FUNCCALL: {
+    auto call = (ExprCallNode *)node;
+    if (call->_ref->getNodeType() == NodeType::VAR_REF &&
+        ((ExprVarRefNode *)call->_ref)->_ident == SIZEOF_FUNC)
+      return node;
+
+    for (auto &arg : call->_args)
+      arg = fold(arg);
+    if (call->func && call->func->_constant)
+      return foldConstCall(call);
+    return node;
+  }
+  default:
+    return node;
+  }
+}
+
+ExprNode *ConstFolder::foldBinary(ExprBinaryNode *node) {
+  if (node->_op == ExprOperator::ASSIGN) {
+    if (node->_left->getNodeType() != NodeType::VAR_REF)
+      node->_left = fold(node->_left);
+    node->_right = fold(node->_right);
+    return node;
+  }
+
+  node->_left = fold(node->_left);
+  node->_right = fold(node->_right);
+
+  ConstValue left, right, result;
+  if (!node->type || !DataType::isNumeric(node->type->raw) ||
+      !ConstValue::read(node->_left, left) ||
+      !ConstValue::read(node->_right, right))
+    return node;
+
+  auto castTo = DataType::getOperationType(left.type, node->_op, right.type);
+  if (DataType::isFloat(castTo->raw) != DataType::isFloat(node->type->raw) ||
+      !ConstValue::binary(node->_op, left, right, node->type, result) ||
+      result.type != node->type)
+    return node;
+
+  return replace(node, result.materialize(node->_loc));
+}
+
+ExprNode *ConstFolder::foldUnary(ExprUnaryNode *node) {
+  // The operand of a reference has to stay addressable
+  if (node->_op == ExprOperator::B_AND) {
+    if (node->_expr->getNodeType() != NodeType::VAR_REF)
+      node->_expr = fold(node->_expr);
+    return node;
+  }
+
+  node->_expr = fold(node->_expr);
+
+  ConstValue value;
+  if (!node->type || !ConstValue::read(node->_expr, value) ||
+      !ConstValue::unary(node->_op, value, node->type) ||
+      value.type != node->type)
+    return node;
+
+  return replace(node, value.materialize(node->_loc));
+}
+
+ExprNode *ConstFolder::foldVarRef(ExprVarRefNode *node) {
+  auto found = constValues.find(node->var);
+  if (found == constValues.end() || found->second->type != node->type)
+    return node;
+
+  ConstValue value;
+  ConstValue::read(found->second, value);
+  return replace(node, value.materialize(node->_loc));
+}
+
+ExprNode *ConstFolder::foldConstCall(ExprCallNode *node) {
+  std::vector<ConstValue> result;
+  if (!interpreter.evaluate(node, result)) {
+    errors.push_back(interpreter.getError());
+    return node;
+  }
+
+  if (node->type->raw != RawDataType::ARRAY)
+    return replace(node, result[0].materialize(node->_loc));
+
+  auto constant = new ExprConstantNode(node->_loc, nullptr, "", LEX_NUMBER);
+  constant->type = node->type;
+  constant->elements.reserve(result.size());
+  for (auto &value : result) {
+    uint64_t bits = value.i;
+    if (DataType::isFloat(value.type->raw))
+      std::memcpy(&bits, &value.f, sizeof bits);
+    constant->elements.push_back(bits);
+  }
+
+  return replace(node, constant);
+}
+
+ExprNode *ConstFolder::replace(ExprNode *node, ExprConstantNode *constant) {
+  auto parent = node->_parent;
+  constant->_parent = parent;
+
+  if (parent)
+    for (auto &child : parent->_children)
+      if (child == node)
+        child = constant;
+
+  return constant;
+}
+
+void ConstFolder::compile_error(std::string msg, AstNode *node) {
+  errors.push_back(node->_loc.str() + " compile error: " + msg);
+}
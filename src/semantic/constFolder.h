@@ -0,0 +1,47 @@
+#ifndef _constFolder
+#define _constFolder
+
+#include "../ast/ast.h"
+#include "../ast/visitor.h"
+#include "../parser/parser.h"
+#include "constInterpreter.h"
+#include <unordered_map>
+
+/*
+  Runs between the validator and the assembler. Expressions over literals
+  and const scalars are evaluated with the same widths and casts the
+  assembler would emit and replaced by a constant node, const scalars are
+  replaced by their value at every use. Calls to const functions are run by
+  the interpreter and replaced by their result.
+*/
+class ConstFolder : public StaticVisitor<ConstFolder> {
+public:
+  void visitProgram(ProgramNode *node);
+  void visitFunction(FunctionNode *node);
+  void visitStructDef(StructDefNode *node);
+  void visitBody(BodyNode *node);
+  void visitVarDef(VarDefNode *node);
+
+  void visitIf(IfNode *node);
+  void visitWhile(WhileNode *node);
+  void visitFor(ForNode *node);
+  void visitReturnNode(ReturnNode *node);
+
+  const std::vector<std::string> getErrors() { return errors; };
+
+private:
+  std::vector<std::string> errors;
+  std::unordered_map<VarDefNode *, ExprConstantNode *> constValues;
+  ConstInterpreter interpreter;
+
+  ExprNode *fold(ExprNode *node);
+  ExprNode *foldBinary(ExprBinaryNode *node);
+  ExprNode *foldUnary(ExprUnaryNode *node);
+  ExprNode *foldVarRef(ExprVarRefNode *node);
+  ExprNode *foldConstCall(ExprCallNode *node);
+
+  ExprNode *replace(ExprNode *node, ExprConstantNode *constant);
+  void compile_error(std::string msg, AstNode *node);
+};
+
+#endif
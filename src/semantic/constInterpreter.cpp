@@ -0,0 +1,635 @@
+#include "constInterpreter.h"
+#include <cmath>
+#include <cstring>
+
+// Enough for any table, low enough to stop a runaway loop in a second or two
+const ulint maxSteps = 100000000;
+const int maxDepth = 512;
+
+// Integers are kept sign extended from the width of their type, which is
+// what llvm leaves after the trunc and sext emitted by the assembler
+static int64_t wrap(int64_t value, DataType *type) {
+  switch (type->size) {
+  case 1:
+    return (int8_t)value;
+  case 2:
+    return (int16_t)value;
+  case 4:
+    return (int32_t)value;
+  default:
+    return value;
+  }
+}
+
+static double narrow(double value, DataType *type) {
+  return type->raw == RawDataType::FLOAT ? (float)value : value;
+}
+
+static bool compare(ExprOperator op, int64_t left, int64_t right) {
+  switch (op) {
+  case ExprOperator::EQ:
+    return left == right;
+  case ExprOperator::NEQ:
+    return left != right;
+  case ExprOperator::GT:
+    return left > right;
+  case ExprOperator::GTE:
+    return left >= right;
+  case ExprOperator::LT:
+    return left < right;
+  case ExprOperator::LTE:
+    return left <= right;
+  case ExprOperator::AND:
+    return left && right;
+  default:
+    return left || right;
+  }
+}
+
+// Ordered comparisons, false whenever a NaN is involved
+static bool compare(ExprOperator op, double left, double right) {
+  switch (op) {
+  case ExprOperator::EQ:
+    return left == right;
+  case ExprOperator::NEQ:
+    return left < right || left > right;
+  case ExprOperator::GT:
+    return left > right;
+  case ExprOperator::GTE:
+    return left >= right;
+  case ExprOperator::LT:
+    return left < right;
+  case ExprOperator::LTE:
+    return left <= right;
+  case ExprOperator::AND:
+    return (left < 0 || left > 0) && (right < 0 || right > 0);
+  default:
+    return (left < 0 || left > 0) || (right < 0 || right > 0);
+  }
+}
+
+// Leaves alone whatever would be undefined or trap at runtime
+static bool arithmetic(ExprOperator op, int64_t left, int64_t right,
+                       DataType *type, int64_t &result) {
+  int64_t bits = type->size * 8;
+  int64_t minimum = wrap((uint64_t)1 << (bits - 1), type);
+
+  switch (op) {
+  case ExprOperator::PLUS:
+    result = (uint64_t)left + (uint64_t)right;
+    break;
+  case ExprOperator::MINUS:
+    result = (uint64_t)left - (uint64_t)right;
+    break;
+  case ExprOperator::MULT:
+    result = (uint64_t)left * (uint64_t)right;
+    break;
+  case ExprOperator::DIV:
+  case ExprOperator::MOD:
+    if (!right || (right == -1 && left == minimum))
+      return false;
+    result = op == ExprOperator::DIV ? left / right : left % right;
+    break;
+  case ExprOperator::B_LSHIFT:
+  case ExprOperator::B_RSHIFT:
+    if (right < 0 || right >= bits)
+      return false;
+    result = op == ExprOperator::B_LSHIFT ? (int64_t)((uint64_t)left << right)
+                                          : left >> right;
+    break;
+  case ExprOperator::B_AND:
+    result = left & right;
+    break;
+  case ExprOperator::B_OR:
+    result = left | right;
+    break;
+  case ExprOperator::B_XOR:
+    result = left ^ right;
+    break;
+  default:
+    return false;
+  }
+
+  result = wrap(result, type);
+  return true;
+}
+
+static bool arithmetic(ExprOperator op, double left, double right,
+                       double &result) {
+  switch (op) {
+  case ExprOperator::PLUS:
+    result = left + right;
+    return true;
+  case ExprOperator::MINUS:
+    result = left - right;
+    return true;
+  case ExprOperator::MULT:
+    result = left * right;
+    return true;
+  case ExprOperator::DIV:
+    result = left / right;
+    return true;
+  case ExprOperator::MOD:
+    result = std::fmod(left, right);
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool ConstValue::read(ExprNode *node, ConstValue &value) {
+  if (node->getNodeType() != NodeType::EXPR_CONSTANT || !node->type ||
+      !DataType::isNumeric(node->type->raw))
+    return false;
+
+  auto constant = (ExprConstantNode *)node;
+  if (constant->_rawType == LEX_STRING)
+    return false;
+
+  value.type = node->type;
+  if (constant->_isFloat) {
+    if (std::fabs(constant->_floatValue) >= 0x1p63)
+      return false;
+    value.i = (int64_t)constant->_floatValue;
+    value.f = constant->_floatValue;
+  } else {
+    value.i = (int64_t)constant->_intValue;
+    value.f = (double)value.i;
+  }
+
+  value.i = wrap(value.i, value.type);
+  value.f = narrow(value.f, value.type);
+  return true;
+}
+
+bool ConstValue::unary(ExprOperator op, ConstValue &value, DataType *type) {
+  bool isFloat = DataType::isFloat(value.type->raw);
+  bool negative = isFloat ? value.f < 0 : value.i < 0;
+
+  switch (op) {
+  case ExprOperator::PLUS:
+    if (!negative)
+      return true;
+    [[fallthrough]];
+  case ExprOperator::MINUS:
+    value.i = wrap(-(uint64_t)value.i, value.type);
+    value.f = -value.f;
+    return true;
+  case ExprOperator::NOT: {
+    bool isZero = isFloat ? value.f == 0 : value.i == 0;
+    value = {type, isZero, (double)isZero};
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+bool ConstValue::binary(ExprOperator op, ConstValue left, ConstValue right,
+                        DataType *type, ConstValue &result) {
+  auto castTo = DataType::getOperationType(left.type, op, right.type);
+  if (!DataType::isNumeric(castTo->raw) || !left.convert(castTo) ||
+      !right.convert(castTo))
+    return false;
+
+  bool isFloat = DataType::isFloat(castTo->raw);
+  if (isLogicalOperator(op)) {
+    bool flag = isFloat ? compare(op, left.f, right.f)
+                        : compare(op, left.i, right.i);
+    result = {type, flag, (double)flag};
+    return true;
+  }
+
+  result = {castTo, 0, 0};
+  return isFloat ? arithmetic(op, left.f, right.f, result.f)
+                 : arithmetic(op, left.i, right.i, castTo, result.i);
+}
+
+bool ConstValue::convert(DataType *to) {
+  if (type == to)
+    return true;
+  if (!DataType::isNumeric(to->raw) ||
+      DataType::isFloat(type->raw) != DataType::isFloat(to->raw))
+    return false;
+
+  type = to;
+  i = wrap(i, to);
+  f = narrow(f, to);
+  return true;
+}
+
+ExprConstantNode *ConstValue::materialize(SourceLoc loc) {
+  ExprConstantNode *constant;
+  if (DataType::isFloat(type->raw)) {
+    double value = narrow(f, type);
+    constant = new ExprConstantNode(loc, nullptr, std::to_string(value),
+                                    LEX_NUMBER, value);
+  } else {
+    int64_t value = wrap(i, type);
+    constant = new ExprConstantNode(loc, nullptr, std::to_string(value),
+                                    LEX_NUMBER, (uint64_t)value);
+  }
+
+  constant->type = type;
+  return constant;
+}
+
+bool ConstInterpreter::isConstType(DataType *type) {
+  if (type->raw == RawDataType::ARRAY)
+    return isConstType(type->inner);
+  return DataType::isNumeric(type->raw);
+}
+
+ulint ConstInterpreter::countOf(DataType *type) {
+  if (type->raw == RawDataType::ARRAY)
+    return type->arrLength * countOf(type->inner);
+  return 1;
+}
+
+DataType *ConstInterpreter::elementOf(DataType *type) {
+  while (type->raw == RawDataType::ARRAY)
+    type = type->inner;
+  return type;
+}
+
+bool ConstInterpreter::evaluate(ExprCallNode *node,
+                                std::vector<ConstValue> &result) {
+  Frame root;
+  frame = &root;
+  steps = 0;
+  depth = 0;
+  error.clear();
+
+  bool evaluated = call(node, result);
+  frame = nullptr;
+  return evaluated;
+}
+
+bool ConstInterpreter::call(ExprCallNode *node,
+                            std::vector<ConstValue> &result) {
+  auto func = node->func;
+  if (!func || !func->_constant)
+    return fail("Only const functions can be called at compile time", node);
+  if (!func->_body)
+    return fail("Const function " + func->_name.str() +
+                    " has no body to be evaluated",
+                node);
+  if (depth >= maxDepth)
+    return fail("Const evaluation is nested more than " +
+                    std::to_string(maxDepth) + " calls deep",
+                node);
+
+  Frame callee;
+  for (auto &[name, var] : func->localVars) {
+    if (!isConstType(var->type))
+      return fail("Variable " + name.str() +
+                      " has a type not supported in const functions",
+                  var);
+
+    callee.vars[var].assign(countOf(var->type),
+                            ConstValue{elementOf(var->type), 0, 0});
+  }
+
+  for (ulint i = 0; i < func->_params.size(); i++) {
+    auto param = func->_params[i];
+    Place to{&callee.vars[param], 0, param->type, false};
+    if (!store(to, node->_args[i]))
+      return false;
+  }
+
+  auto caller = frame;
+  frame = &callee;
+  depth++;
+  auto flow = execBody(func->_body);
+  frame = caller;
+  depth--;
+
+  if (flow == Flow::FAIL)
+    return false;
+  if (flow != Flow::RETURN)
+    return fail("Const function " + func->_name.str() +
+                    " ended without returning a value",
+                node);
+
+  result = std::move(callee.result);
+  return true;
+}
+
+ConstInterpreter::Flow ConstInterpreter::exec(AstNode *node) {
+  if (!tick(node))
+    return Flow::FAIL;
+
+  switch (node->getNodeType()) {
+  case NodeType::BODY:
+    return execBody((BodyNode *)node);
+  case NodeType::VAR_DEF:
+    return execVarDef((VarDefNode *)node);
+  case NodeType::IF: {
+    auto ifNode = (IfNode *)node;
+    bool isTrue;
+    if (!condition(ifNode->_expr, isTrue))
+      return Flow::FAIL;
+    if (isTrue)
+      return execBody(ifNode->_ifBody);
+    return ifNode->_elseBody ? execBody(ifNode->_elseBody) : Flow::NEXT;
+  }
+  case NodeType::WHILE: {
+    auto whileNode = (WhileNode *)node;
+    while (true) {
+      bool isTrue;
+      if (!condition(whileNode->_expr, isTrue))
+        return Flow::FAIL;
+      if (!isTrue)
+        return Flow::NEXT;
+
+      auto flow = execBody(whileNode->_body);
+      if (flow == Flow::BREAK)
+        return Flow::NEXT;
+      if (flow != Flow::NEXT)
+        return flow;
+    }
+  }
+  case NodeType::FOR: {
+    auto forNode = (ForNode *)node;
+    if (forNode->_start && !discard(forNode->_start))
+      return Flow::FAIL;
+
+    while (true) {
+      bool isTrue = true;
+      if (forNode->_cond && !condition(forNode->_cond, isTrue))
+        return Flow::FAIL;
+      if (!isTrue)
+        return Flow::NEXT;
+
+      auto flow = execBody(forNode->_body);
+      if (flow == Flow::BREAK)
+        return Flow::NEXT;
+      if (flow != Flow::NEXT)
+        return flow;
+
+      if (forNode->_inc && !discard(forNode->_inc))
+        return Flow::FAIL;
+    }
+  }
+  case NodeType::BREAK:
+    return Flow::BREAK;
+  case NodeType::RETURN: {
+    auto returnNode = (ReturnNode *)node;
+    auto &result = frame->result;
+    result.assign(countOf(returnNode->retType),
+                  ConstValue{elementOf(returnNode->retType), 0, 0});
+
+    Place to{&result, 0, returnNode->retType, false};
+    return store(to, returnNode->_expr) ? Flow::RETURN : Flow::FAIL;
+  }
+  default:
+    if (node->isExpr())
+      return discard((ExprNode *)node) ? Flow::NEXT : Flow::FAIL;
+
+    fail("Statement not supported in const functions", node);
+    return Flow::FAIL;
+  }
+}
+
+ConstInterpreter::Flow ConstInterpreter::execBody(BodyNode *node) {
+  for (auto statement : node->_statements) {
+    auto flow = exec(statement);
+    frame->temporaries.clear();
+    if (flow != Flow::NEXT)
+      return flow;
+  }
+
+  return Flow::NEXT;
+}
+
+ConstInterpreter::Flow ConstInterpreter::execVarDef(VarDefNode *node) {
+  if (!node->_defaultVal)
+    return Flow::NEXT;
+
+  Place to{&frame->vars[node], 0, node->type, false};
+  return store(to, node->_defaultVal) ? Flow::NEXT : Flow::FAIL;
+}
+
+bool ConstInterpreter::discard(ExprNode *node) {
+  if (node->getNodeType() == NodeType::EXPR_BINARY &&
+      ((ExprBinaryNode *)node)->_op == ExprOperator::ASSIGN)
+    return assign((ExprBinaryNode *)node, nullptr);
+
+  if (node->type && node->type->raw == RawDataType::ARRAY) {
+    Place at;
+    return place(node, at);
+  }
+
+  ConstValue value;
+  return scalar(node, value);
+}
+
+bool ConstInterpreter::condition(ExprNode *node, bool &isTrue) {
+  ConstValue value;
+  if (!scalar(node, value))
+    return false;
+
+  isTrue = DataType::isFloat(value.type->raw) ? value.f < 0 || value.f > 0
+                                               : value.i != 0;
+  return true;
+}
+
+bool ConstInterpreter::scalar(ExprNode *node, ConstValue &value) {
+  if (!tick(node))
+    return false;
+
+  switch (node->getNodeType()) {
+  case NodeType::EXPR_CONSTANT:
+    if (!ConstValue::read(node, value))
+      return fail("Only numbers can be used at compile time", node);
+    return true;
+  case NodeType::VAR_REF:
+  case NodeType::INDEX_ACCESS: {
+    Place at;
+    if (!place(node, at))
+      return false;
+    if (at.type->raw == RawDataType::ARRAY)
+      return fail("Expecting a number, found an array", node);
+
+    value = (*at.cells)[at.offset];
+    return true;
+  }
+  case NodeType::EXPR_UNARY: {
+    auto unary = (ExprUnaryNode *)node;
+    if (unary->_op == ExprOperator::MULT || unary->_op == ExprOperator::B_AND)
+      return fail("Pointers are not supported in const functions", node);
+
+    if (!scalar(unary->_expr, value))
+      return false;
+    if (!ConstValue::unary(unary->_op, value, node->type) ||
+        !value.convert(node->type))
+      return fail("Invalid operation " + std::string(operatorName(unary->_op)),
+                  node);
+    return true;
+  }
+  case NodeType::EXPR_BINARY: {
+    auto binary = (ExprBinaryNode *)node;
+    if (binary->_op == ExprOperator::ASSIGN)
+      return assign(binary, &value);
+
+    ConstValue left, right;
+    if (!scalar(binary->_left, left) || !scalar(binary->_right, right))
+      return false;
+    if (!ConstValue::binary(binary->_op, left, right, node->type, value) ||
+        !value.convert(node->type))
+      return fail("Operation " + std::string(operatorName(binary->_op)) +
+                      " is undefined for " + std::to_string(left.i) +
+                      " and " + std::to_string(right.i),
+                  node);
+    return true;
+  }
+  case NodeType::FUNCCALL: {
+    std::vector<ConstValue> result;
+    if (!call((ExprCallNode *)node, result))
+      return false;
+    if (node->type->raw == RawDataType::ARRAY)
+      return fail("Expecting a number, found an array", node);
+
+    value = result[0];
+    return true;
+  }
+  case NodeType::MEMBER_ACCESS:
+    return fail("Structs are not supported in const functions", node);
+  default:
+    return fail("Expression not supported in const functions", node);
+  }
+}
+
+bool ConstInterpreter::place(ExprNode *node, Place &out) {
+  if (!tick(node))
+    return false;
+
+  switch (node->getNodeType()) {
+  case NodeType::VAR_REF: {
+    auto var = node->var;
+    auto local = frame->vars.find(var);
+    if (local != frame->vars.end()) {
+      out = {&local->second, 0, var->type, var->_constant};
+      return true;
+    }
+
+    auto name = ((ExprVarRefNode *)node)->_ident.str();
+    if (!var || !var->_constant || !var->_defaultVal ||
+        var->_defaultVal->getNodeType() != NodeType::EXPR_CONSTANT ||
+        !isConstType(var->type))
+      return fail(name + " is not known at compile time", node);
+
+    auto [global, inserted] = globals.try_emplace(var);
+    if (inserted) {
+      auto constant = (ExprConstantNode *)var->_defaultVal;
+      auto element = elementOf(var->type);
+      auto &cells = global->second;
+
+      if (var->type->raw == RawDataType::ARRAY) {
+        for (auto bits : constant->elements) {
+          double f;
+          std::memcpy(&f, &bits, sizeof f);
+          cells.push_back(DataType::isFloat(element->raw)
+                              ? ConstValue{element, (int64_t)f, f}
+                              : ConstValue{element, (int64_t)bits,
+                                           (double)(int64_t)bits});
+        }
+      } else {
+        ConstValue value;
+        if (ConstValue::read(constant, value) && value.convert(var->type))
+          cells.push_back(value);
+      }
+
+      if (cells.size() != countOf(var->type)) {
+        globals.erase(global);
+        return fail(name + " is not known at compile time", node);
+      }
+    }
+
+    out = {&global->second, 0, var->type, true};
+    return true;
+  }
+  case NodeType::INDEX_ACCESS: {
+    auto index = (ExprIndex *)node;
+    if (!place(index->_inner, out))
+      return false;
+    if (out.type->raw != RawDataType::ARRAY)
+      return fail("Pointers are not supported in const functions", node);
+
+    ConstValue at;
+    if (!scalar(index->_index, at))
+      return false;
+    if (at.i < 0 || (ulint)at.i >= out.type->arrLength)
+      return fail("Index " + std::to_string(at.i) +
+                      " out of bounds for an array of " +
+                      std::to_string(out.type->arrLength) + " elements",
+                  node);
+
+    out.type = out.type->inner;
+    out.offset += at.i * countOf(out.type);
+    return true;
+  }
+  case NodeType::FUNCCALL: {
+    auto &result = frame->temporaries.emplace_back();
+    if (!call((ExprCallNode *)node, result))
+      return false;
+
+    out = {&result, 0, node->type, true};
+    return true;
+  }
+  case NodeType::MEMBER_ACCESS:
+    return fail("Structs are not supported in const functions", node);
+  default:
+    return fail("Expression not supported in const functions", node);
+  }
+}
+
+bool ConstInterpreter::assign(ExprBinaryNode *node, ConstValue *value) {
+  Place to;
+  if (!place(node->_left, to))
+    return false;
+  if (to.constant)
+    return fail("Assignment to constant variable", node);
+
+  return store(to, node->_right, value);
+}
+
+bool ConstInterpreter::store(Place &to, ExprNode *from, ConstValue *value) {
+  if (to.type->raw != RawDataType::ARRAY) {
+    ConstValue stored;
+    if (!scalar(from, stored))
+      return false;
+    if (value)
+      *value = stored;
+    if (!stored.convert(to.type))
+      return fail("Invalid cast", from);
+
+    (*to.cells)[to.offset] = stored;
+    return true;
+  }
+
+  Place at;
+  if (!place(from, at))
+    return false;
+  if (at.type != to.type)
+    return fail("Array sizes do not match", from);
+
+  auto begin = at.cells->begin() + at.offset;
+  std::vector<ConstValue> copied(begin, begin + countOf(at.type));
+  std::copy(copied.begin(), copied.end(), to.cells->begin() + to.offset);
+  return true;
+}
+
+bool ConstInterpreter::tick(AstNode *node) {
+  if (++steps <= maxSteps)
+    return true;
+  return fail("Const evaluation took more than " + std::to_string(maxSteps) +
+                  " steps",
+              node);
+}
+
+bool ConstInterpreter::fail(std::string msg, AstNode *node) {
+  if (error.empty())
+    error = node->_loc.str() + " compile error: " + msg;
+  return false;
+}
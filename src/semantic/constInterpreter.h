@@ -0,0 +1,88 @@
+#ifndef _constInterpreter
+#define _constInterpreter
+
+#include "../ast/ast.h"
+#include "../parser/parser.h"
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+  A number as the assembler would compute it, integers are kept sign extended
+  from the width of their type.
+*/
+struct ConstValue {
+  DataType *type = nullptr;
+  int64_t i = 0;
+  double f = 0;
+
+  // Numeric constant nodes only, strings and null pointers are left out
+  static bool read(ExprNode *node, ConstValue &value);
+  static bool unary(ExprOperator op, ConstValue &value, DataType *type);
+  // Arithmetic results are in the operation type, comparisons in the given
+  // one. False where the assembler would fail or the result is undefined
+  static bool binary(ExprOperator op, ConstValue left, ConstValue right,
+                     DataType *type, ConstValue &result);
+
+  // Same conversions Assembler::getCast does, false where it would fail
+  bool convert(DataType *to);
+  ExprConstantNode *materialize(SourceLoc loc);
+};
+
+/*
+  Executes const functions over the validated tree. Every variable is
+  flattened into its scalars, arrays keep the elements in row-major order so
+  indexing is an offset and copies are plain vector copies. Pointers and
+  structs are not supported, const functions can only call each other.
+*/
+class ConstInterpreter {
+public:
+  // The arguments must be known at compile time, that is constants or const
+  // globals already folded
+  bool evaluate(ExprCallNode *node, std::vector<ConstValue> &result);
+  std::string getError() { return error; }
+
+  static bool isConstType(DataType *type);
+  static ulint countOf(DataType *type);
+  static DataType *elementOf(DataType *type);
+
+private:
+  struct Place {
+    std::vector<ConstValue> *cells;
+    ulint offset;
+    DataType *type;
+    bool constant;
+  };
+
+  struct Frame {
+    std::unordered_map<VarDefNode *, std::vector<ConstValue>> vars;
+    std::deque<std::vector<ConstValue>> temporaries;
+    std::vector<ConstValue> result;
+  };
+
+  enum class Flow { NEXT, BREAK, RETURN, FAIL };
+
+  Frame *frame = nullptr;
+  std::unordered_map<VarDefNode *, std::vector<ConstValue>> globals;
+  ulint steps = 0;
+  int depth = 0;
+  std::string error;
+
+  Flow exec(AstNode *node);
+  Flow execBody(BodyNode *node);
+  Flow execVarDef(VarDefNode *node);
+
+  bool call(ExprCallNode *node, std::vector<ConstValue> &result);
+  bool discard(ExprNode *node);
+  bool condition(ExprNode *node, bool &isTrue);
+  bool scalar(ExprNode *node, ConstValue &value);
+  bool place(ExprNode *node, Place &out);
+  bool assign(ExprBinaryNode *node, ConstValue *value);
+  bool store(Place &to, ExprNode *from, ConstValue *value = nullptr);
+
+  bool tick(AstNode *node);
+  bool fail(std::string msg, AstNode *node);
+};
+
+#endif
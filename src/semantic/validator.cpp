@@ -1,9 +1,53 @@
 #include "validator.h"
+#include "constInterpreter.h"
 
 inline bool isValidConditionType(DataType *type) {
   return DataType::isNumeric(type->raw) || DataType::isAddress(type->raw);
 }
 
+// Spelled the way the source does, also the identifier of basic types
+static std::string typeName(DataType *type) {
+  switch (type->raw) {
+  case RawDataType::POINTER:
+    return "*" + typeName(type->inner);
+  case RawDataType::ARRAY:
+    return typeName(type->inner) + "[" + std::to_string(type->arrLength) + "]";
+  case RawDataType::STRUCT:
+    return type->ident.str();
+  case RawDataType::CHAR:
+    return "char";
+  case RawDataType::SHORT:
+    return "short";
+  case RawDataType::INT:
+    return "int";
+  case RawDataType::LONG:
+    return "long";
+  case RawDataType::FLOAT:
+    return "float";
+  case RawDataType::DOUBLE:
+    return "double";
+  default:
+    return "void";
+  }
+}
+
+static TypeDefNode *typeDefOf(DataType *type, SourceLoc loc) {
+  if (type->raw == RawDataType::POINTER)
+    return TypeDefNode::buildPointer(typeDefOf(type->inner, loc), loc);
+  if (type->raw == RawDataType::ARRAY)
+    return TypeDefNode::buildArray(typeDefOf(type->inner, loc),
+                                   type->arrLength, loc);
+  return TypeDefNode::build(typeName(type), loc);
+}
+
+// Numbers written in the source, 1 or -1, which fit any numeric parameter
+static bool isLiteral(ExprNode *node) {
+  if (node->getNodeType() == NodeType::EXPR_UNARY)
+    return isLiteral(((ExprUnaryNode *)node)->_expr);
+  return node->getNodeType() == NodeType::EXPR_CONSTANT &&
+         ((ExprConstantNode *)node)->_rawType == LEX_NUMBER;
+}
+
 SemanticValidator::SemanticValidator(bool validateMain) {
   function = nullptr;
   program = nullptr;
@@ -17,12 +61,14 @@ void SemanticValidator::visitProgram(ProgramNode *node) {
   this->program = node;
 
   for (auto child : node->_children) {
+    user = child;
     auto childType = child->getNodeType();
     switch (childType) {
     case NodeType::FUNCTION: {
       auto funcNode = (FunctionNode *)child;
-      if (node->funcs.find(funcNode->_name) != node->funcs.end())
-        compile_error("Duplicated function name: " + funcNode->_name, node);
+      if (node->funcs.contains(funcNode->_name))
+        compile_error("Duplicated function name: " + funcNode->_name.str(),
+                      node);
       node->funcs[funcNode->_name] = funcNode;
       break;
     }
@@ -31,15 +77,17 @@ void SemanticValidator::visitProgram(ProgramNode *node) {
       if (!structNode->_genericArgNames.empty())
         break;
 
-      if (node->structDefs.find(structNode->_name) != node->structDefs.end())
-        compile_error("Duplicated struct name: " + structNode->_name, node);
+      if (node->structDefs.contains(structNode->_name))
+        compile_error("Duplicated struct name: " + structNode->_name.str(),
+                      node);
       node->structDefs[structNode->_name] = structNode;
       break;
     }
     case NodeType::VAR_DEF: {
       auto varDefNode = (VarDefNode *)child;
-      if (node->globalVars.find(varDefNode->_name) != node->globalVars.end())
-        compile_error("Duplicated function name: " + varDefNode->_name, node);
+      if (node->globalVars.contains(varDefNode->_name))
+        compile_error("Duplicated function name: " + varDefNode->_name.str(),
+                      node);
       node->globalVars[varDefNode->_name] = varDefNode;
       break;
     }
@@ -48,30 +96,54 @@ void SemanticValidator::visitProgram(ProgramNode *node) {
       break;
     }
 
-    child->visit(this);
+    visit(child);
+  }
+
+  if (!instances.empty()) {
+    std::vector<AstNode *> children;
+    for (auto child : node->_children) {
+      auto found = instances.find(child);
+      if (found != instances.end())
+        children.insert(children.end(), found->second.begin(),
+                        found->second.end());
+      children.push_back(child);
+    }
+    node->_children = std::move(children);
   }
 
-  if (!node->funcs[MAIN_FUNC] && validateMain) {
+  if (!node->funcs.lookup(MAIN_FUNC) && validateMain) {
     compile_error("main function not defined ", node);
     return;
   }
   if (validateMain) {
-    auto mainFn = node->funcs[MAIN_FUNC];
-    if (mainFn->_retTypeDef->_rawIdent != "int") {
+    auto mainFn = node->funcs.lookup(MAIN_FUNC);
+    if (mainFn->_retTypeDef->_rawIdent != Symbol("int")) {
       type_error("main function return type should be int", node);
     }
   }
 }
 
 void SemanticValidator::visitFunction(FunctionNode *node) {
+  // Templates are validated per instance, with the deduced types
+  if (!node->_genericArgNames.empty()) {
+    bool method =
+        node->_parent && node->_parent->getNodeType() == NodeType::STRUCT_DEF;
+    if (node->_external || method) {
+      compile_error("Only functions with a body outside structs can be generic",
+                    node);
+      node->retType = DataType::build(RawDataType::ERROR);
+    }
+    return;
+  }
+
   if (reservedFunctions.find(node->_name) != reservedFunctions.end()) {
-    name_error("Use of reserved function name " + node->_name, node);
+    name_error("Use of reserved function name " + node->_name.str(), node);
     node->retType = DataType::build(RawDataType::ERROR);
     return;
   }
 
   for (auto param : node->_params) {
-    if (node->localVars.find(param->_name) != node->localVars.end())
+    if (node->localVars.contains(param->_name))
       compile_error("Duplicated param name", node);
     node->localVars[param->_name] = param;
 
@@ -82,21 +154,31 @@ void SemanticValidator::visitFunction(FunctionNode *node) {
 
   if (node->_external) {
     if (!node->retType) {
-      node->visitChildren(this);
+      visitChildren(node);
       node->retType = node->_retTypeDef->dataType;
     }
     return;
   }
 
   for (auto localVar : node->_innerVars) {
-    if (node->localVars.find(localVar->_name) != node->localVars.end())
+    if (node->localVars.contains(localVar->_name))
       compile_error("Duplicated local variable name", node);
     node->localVars[localVar->_name] = localVar;
   }
 
-  node->visitChildren(this);
+  visitChildren(node);
   node->retType = node->_retTypeDef->dataType;
 
+  if (node->_constant) {
+    bool constTypes = ConstInterpreter::isConstType(node->retType);
+    for (auto param : node->_params)
+      constTypes = constTypes && ConstInterpreter::isConstType(param->type);
+    if (!constTypes)
+      type_error("Const function " + node->_name.str() +
+                     " can only take and return numbers or arrays of them",
+                 node);
+  }
+
   if (!outWithReturn && node->retType->raw != RawDataType::VOID)
     compile_error("Control reaches end of non-void function", node);
 
@@ -114,17 +196,17 @@ void SemanticValidator::visitStructDef(StructDefNode *node) {
   for (auto member : node->_members) {
     switch (member->getNodeType()) {
     case NodeType::VAR_DEF: {
-      member->visit(this);
+      visit(member);
       auto varDefNode = (VarDefNode *)member;
-      if (node->membersDef.find(varDefNode->_name) != node->membersDef.end())
+      if (node->membersDef.contains(varDefNode->_name))
         compile_error("Duplicated name for member, there are another struct "
                       "member with the same name: " +
-                          varDefNode->_name,
+                          varDefNode->_name.str(),
                       node);
-      if (node->funcMembers.find(varDefNode->_name) != node->funcMembers.end())
+      if (node->funcMembers.contains(varDefNode->_name))
         compile_error("Duplicated name for member, there are another struct "
                       "function with the same name" +
-                          varDefNode->_name,
+                          varDefNode->_name.str(),
                       node);
       if (!varDefNode->_initArgs.empty())
         compile_error("Struct members cannot have init args", node);
@@ -143,19 +225,19 @@ void SemanticValidator::visitStructDef(StructDefNode *node) {
   }
 
   for (auto funcNode : structFuncs) {
-    funcNode->visit(this);
+    visit(funcNode);
     if (funcNode->retType->raw == RawDataType::ERROR)
       continue;
 
-    if (node->membersDef.find(funcNode->_name) != node->membersDef.end())
+    if (node->membersDef.contains(funcNode->_name))
       compile_error("Duplicated name for function, there are another struct "
                     "function with the same name" +
-                        funcNode->_name,
+                        funcNode->_name.str(),
                     node);
-    if (node->funcMembers.find(funcNode->_name) != node->funcMembers.end())
+    if (node->funcMembers.contains(funcNode->_name))
       compile_error("Duplicated name for function, there are another struct "
                     "function with the same name" +
-                        funcNode->_name,
+                        funcNode->_name.str(),
                     node);
 
     if (funcNode->_name == INIT_FUNC)
@@ -166,7 +248,7 @@ void SemanticValidator::visitStructDef(StructDefNode *node) {
 
     auto wrongParameter = [&]() {
       compile_error(
-          "Function " + funcNode->_name +
+          "Function " + funcNode->_name.str() +
               " has invalid parameters, function defined inside structs should "
               "receive a pointer to the struct as first parameter",
           node);
@@ -193,7 +275,7 @@ void SemanticValidator::visitBody(BodyNode *node) {
   outWithReturn = false;
   for (ulint i = 0; i < node->_statements.size(); i++) {
     auto statement = node->_statements[i];
-    statement->visit(this);
+    visit(statement);
 
     if (!outWithReturn)
       continue;
@@ -205,25 +287,21 @@ void SemanticValidator::visitBody(BodyNode *node) {
 }
 
 void SemanticValidator::visitVarDef(VarDefNode *node) {
-  node->visitChildren(this);
+  visitChildren(node);
 
   node->type = node->_typeDef->dataType;
   if (function)
     function->localVars[node->_name] = node;
-  else {
-    if (node->_defaultVal &&
-        node->_defaultVal->getNodeType() != NodeType::EXPR_CONSTANT)
-      compile_error("Default value in global variable should be constant",
-                    node);
-  }
 
   if (node->_defaultVal) {
-    bool correctType =
-        DataType::getResultType(node->type, "=", node->_defaultVal->type);
+    bool correctType = DataType::getResultType(
+        node->type, ExprOperator::ASSIGN, node->_defaultVal->type);
 
     if (node->_defaultVal->getNodeType() == NodeType::EXPR_CONSTANT) {
       auto constant = (ExprConstantNode *)node->_defaultVal;
-      if (node->type->raw == RawDataType::POINTER && constant->_rawValue == "0")
+      if (node->type->raw == RawDataType::POINTER &&
+          constant->_rawType == LEX_NUMBER && !constant->_isFloat &&
+          constant->_intValue == 0)
         correctType = true;
 
       node->_defaultVal->type = node->type;
@@ -248,20 +326,19 @@ void SemanticValidator::visitVarDef(VarDefNode *node) {
     return;
   }
 
-  bool structHasInit =
-      structDef->funcMembers.find(INIT_FUNC) != structDef->funcMembers.end();
-  bool structInitHasArgs =
-      structHasInit && structDef->funcMembers[INIT_FUNC]->_params.size() > 0;
+  auto initFunc = structDef->funcMembers.lookup(INIT_FUNC);
+  bool structInitHasArgs = initFunc && initFunc->_params.size() > 0;
 
   if (!hasInitArgs && structInitHasArgs) {
-    compile_error("Init args for struct " + structDef->_name +
+    compile_error("Init args for struct " + structDef->_name.str() +
                       " were not provided",
                   node);
     node->type = DataType::build(RawDataType::ERROR);
     return;
   }
   if (hasInitArgs && !structInitHasArgs) {
-    compile_error("Init args were provided for struct " + structDef->_name +
+    compile_error("Init args were provided for struct " +
+                      structDef->_name.str() +
                       ", but the struct init does not have params",
                   node);
     node->type = DataType::build(RawDataType::ERROR);
@@ -274,29 +351,26 @@ void SemanticValidator::visitVarDef(VarDefNode *node) {
   if (!structInitHasArgs)
     return;
 
-  auto funcNode = structDef->funcMembers[INIT_FUNC];
-
-  auto varRef = new ExprVarRefNode(node->_filename, node->_line,
-                                   node->_startCol, node, node->_name);
-  auto refToStruct = new ExprUnaryNode(node->_filename, node->_line,
-                                       node->_startCol, node, "&", 0, varRef);
+  auto varRef = new ExprVarRefNode(node->_loc, node, node->_name);
+  auto refToStruct =
+      new ExprUnaryNode(node->_loc, node, ExprOperator::B_AND, varRef);
 
   node->_initArgs.insert(node->_initArgs.begin(), refToStruct);
 
-  validateArgs(funcNode, node->_initArgs);
+  validateArgs(initFunc, node->_initArgs);
 }
 
 void SemanticValidator::visitIf(IfNode *node) {
-  node->_expr->visit(this);
+  visit(node->_expr);
 
   auto exprType = node->_expr->type->raw;
 
-  node->_ifBody->visit(this);
+  visit(node->_ifBody);
   bool ifWithReturn = outWithReturn;
   bool elseWithReturn = false;
 
   if (node->_elseBody) {
-    node->_elseBody->visit(this);
+    visit(node->_elseBody);
     elseWithReturn = outWithReturn;
   }
 
@@ -313,7 +387,7 @@ void SemanticValidator::visitIf(IfNode *node) {
 }
 
 void SemanticValidator::visitFor(ForNode *node) {
-  node->visitChildren(this);
+  visitChildren(node);
   outWithReturn = false;
   if (!isValidConditionType(node->_cond->type) &&
       node->_cond->type->raw != RawDataType::VOID)
@@ -321,7 +395,7 @@ void SemanticValidator::visitFor(ForNode *node) {
 }
 
 void SemanticValidator::visitWhile(WhileNode *node) {
-  node->visitChildren(this);
+  visitChildren(node);
   outWithReturn = false;
   if (!isValidConditionType(node->_expr->type) &&
       node->_expr->type->raw != RawDataType::VOID)
@@ -329,7 +403,18 @@ void SemanticValidator::visitWhile(WhileNode *node) {
 }
 
 void SemanticValidator::visitTypeDefNode(TypeDefNode *node) {
-  node->visitChildren(this);
+  visitChildren(node);
+
+  if (node->_valueArg || !node->_arrSizeParam.empty()) {
+    compile_error(node->_valueArg
+                      ? "Integer " + node->_rawIdent.str() + " used as a type"
+                      : "Array size " + node->_arrSizeParam.str() +
+                            " is not an integer template parameter",
+                  node);
+    node->dataType = DataType::build(RawDataType::ERROR);
+    return;
+  }
+
   node->dataType = DataType::build(node);
 
   DataType *datatype = node->dataType;
@@ -346,7 +431,7 @@ void SemanticValidator::visitTypeDefNode(TypeDefNode *node) {
   if (resolveStruct(datatype->ident))
     return;
 
-  name_error("Invalid reference for struct: " + datatype->ident, node);
+  name_error("Invalid reference for struct: " + datatype->ident.str(), node);
 }
 
 void SemanticValidator::visitBreakNode(BreakNode *node) {
@@ -360,7 +445,7 @@ void SemanticValidator::visitBreakNode(BreakNode *node) {
 void SemanticValidator::visitReturnNode(ReturnNode *node) {
   outWithReturn = true;
 
-  node->visitChildren(this);
+  visitChildren(node);
 
   if (!this->function) {
     compile_error("Return statement outside any function", node);
@@ -370,7 +455,8 @@ void SemanticValidator::visitReturnNode(ReturnNode *node) {
   auto funcRetType = function->_retTypeDef->dataType;
   auto exprType =
       node->_expr ? node->_expr->type : DataType::build(RawDataType::VOID);
-  if (DataType::getResultType(funcRetType, "=", exprType) != funcRetType)
+  if (DataType::getResultType(funcRetType, ExprOperator::ASSIGN, exprType) !=
+      funcRetType)
     type_error("Incompatible return type", node);
   node->retType = funcRetType;
 }
@@ -388,7 +474,7 @@ void SemanticValidator::visitExprVarRef(ExprVarRefNode *node) {
   auto varDef = resolveVar(node->_ident);
   auto funcDef = resolveFunction(node->_ident);
   if (!varDef && !funcDef) {
-    name_error("Reference " + node->_ident + " does not exists", node);
+    name_error("Reference " + node->_ident.str() + " does not exists", node);
     node->type = DataType::build(RawDataType::ERROR);
     return;
   }
@@ -403,7 +489,8 @@ void SemanticValidator::visitExprVarRef(ExprVarRefNode *node) {
 void SemanticValidator::visitExprConstant(ExprConstantNode *node) {
   switch (node->_rawType) {
   case LEX_NUMBER:
-    node->type = DataType::fromNumber(node->_rawValue);
+    node->type = node->_isFloat ? DataType::fromFloat(node->_floatValue)
+                                : DataType::fromInteger(node->_intValue);
     break;
   case LEX_CHAR:
     node->type = DataType::fromChar(node->_rawValue);
@@ -426,10 +513,10 @@ void SemanticValidator::visitExprConstant(ExprConstantNode *node) {
 }
 
 void SemanticValidator::visitExprUnaryOp(ExprUnaryNode *node) {
-  node->visitChildren(this);
+  visit(node->_expr);
 
-  switch (node->_op[0]) {
-  case '*': {
+  switch (node->_op) {
+  case ExprOperator::MULT: {
     if (!DataType::isAddress(node->_expr->type->raw)) {
       compile_error("Dereference of non-pointer datatype", node);
       node->type = DataType::build(RawDataType::ERROR);
@@ -439,7 +526,7 @@ void SemanticValidator::visitExprUnaryOp(ExprUnaryNode *node) {
     node->type = node->_expr->type->inner;
     break;
   }
-  case '&': {
+  case ExprOperator::B_AND: {
     if (node->_expr->getNodeType() == NodeType::EXPR_CONSTANT) {
       compile_error("Reference of a constant value", node);
       node->type = DataType::build(RawDataType::ERROR);
@@ -448,7 +535,7 @@ void SemanticValidator::visitExprUnaryOp(ExprUnaryNode *node) {
     node->type = DataType::buildPointer(node->_expr->type);
     break;
   }
-  case '+': {
+  case ExprOperator::PLUS: {
     if (!DataType::isNumeric(node->_expr->type->raw)) {
       type_error("Invalid operation + for type", node);
       node->type = DataType::build(RawDataType::ERROR);
@@ -456,7 +543,7 @@ void SemanticValidator::visitExprUnaryOp(ExprUnaryNode *node) {
     node->type = node->_expr->type;
     break;
   }
-  case '-': {
+  case ExprOperator::MINUS: {
     if (!DataType::isNumeric(node->_expr->type->raw)) {
       type_error("Invalid operation - for type", node);
       node->type = DataType::build(RawDataType::ERROR);
@@ -464,20 +551,24 @@ void SemanticValidator::visitExprUnaryOp(ExprUnaryNode *node) {
     node->type = node->_expr->type;
     break;
   }
-  case '!':
+  case ExprOperator::NOT:
     node->type = DataType::build(RawDataType::INT);
     break;
+  default:
+    unexpected_error("Invalid unary operator", node);
   }
 }
 
 void SemanticValidator::visitExprBinaryOp(ExprBinaryNode *node) {
-  node->visitChildren(this);
+  visit(node->_left);
+  visit(node->_right);
   node->type =
       DataType::getResultType(node->_left->type, node->_op, node->_right->type);
 
-  if (node->type->raw == RawDataType::ERROR &&
-      (node->_left->type != node->_right->type)) {
-    type_error("Expression with invalid types for operator " + node->_op, node);
+  if (node->type->raw == RawDataType::ERROR) {
+    type_error("Expression with invalid types for operator " +
+                   std::string(operatorName(node->_op)),
+               node);
   }
 
   if (node->_right->getNodeType() == NodeType::EXPR_CONSTANT &&
@@ -491,7 +582,7 @@ void SemanticValidator::visitExprBinaryOp(ExprBinaryNode *node) {
     node->_left->type = node->type;
   }
 
-  if (node->_op == "=") {
+  if (node->_op == ExprOperator::ASSIGN) {
     if (!node->_left->var) {
       node->type = DataType::build(RawDataType::ERROR);
       return;
@@ -503,7 +594,7 @@ void SemanticValidator::visitExprBinaryOp(ExprBinaryNode *node) {
 }
 
 void SemanticValidator::visitMemberAccess(ExprMemberAccess *node) {
-  node->_struct->visit(this);
+  visit(node->_struct);
   node->type = DataType::build(RawDataType::ERROR);
 
   if (node->_struct->type->raw != RawDataType::STRUCT) {
@@ -514,22 +605,16 @@ void SemanticValidator::visitMemberAccess(ExprMemberAccess *node) {
   auto structName = node->_struct->type->ident;
   node->structDef = resolveStruct(structName);
   if (!node->structDef) {
-    name_error("Struct " + structName + " does not exist", node);
+    name_error("Struct " + structName.str() + " does not exist", node);
     return;
   }
 
-  auto memberDef = node->structDef->membersDef.find(node->_memberName) !=
-                           node->structDef->membersDef.end()
-                       ? node->structDef->membersDef[node->_memberName]
-                       : nullptr;
-  auto funcDef = node->structDef->funcMembers.find(node->_memberName) !=
-                         node->structDef->funcMembers.end()
-                     ? node->structDef->funcMembers[node->_memberName]
-                     : nullptr;
+  auto memberDef = node->structDef->membersDef.lookup(node->_memberName);
+  auto funcDef = node->structDef->funcMembers.lookup(node->_memberName);
 
   if (!memberDef && !funcDef) {
-    name_error("Member " + node->_memberName + " does not exist on struct " +
-                   structName,
+    name_error("Member " + node->_memberName.str() +
+                   " does not exist on struct " + structName.str(),
                node);
     return;
   }
@@ -542,7 +627,8 @@ void SemanticValidator::visitMemberAccess(ExprMemberAccess *node) {
 }
 
 void SemanticValidator::visitIndexAccess(ExprIndex *node) {
-  node->visitChildren(this);
+  visit(node->_inner);
+  visit(node->_index);
 
   if (!node->_inner->type || !DataType::isAddress(node->_inner->type->raw)) {
     type_error("Indexing non-address datatype", node);
@@ -562,19 +648,31 @@ void SemanticValidator::visitIndexAccess(ExprIndex *node) {
 void SemanticValidator::visitExprCall(ExprCallNode *node) {
   if (node->_ref->getNodeType() == NodeType::VAR_REF) {
     auto funcName = ((ExprVarRefNode *)node->_ref)->_ident;
-    if (funcName == "sizeof")
+    if (funcName == SIZEOF_FUNC)
       return visitSizeOfCall(node);
 
     auto funcDef = resolveFunction(funcName);
     if (!funcDef) {
-      name_error("Function " + funcName + " does not exists", node);
+      name_error("Function " + funcName.str() + " does not exists", node);
+      return;
+    }
+
+    if (!funcDef->_genericArgNames.empty()) {
+      funcDef = instantiate(funcDef, node);
+      if (!funcDef) {
+        node->type = DataType::build(RawDataType::ERROR);
+        return;
+      }
+      node->func = funcDef;
+      node->type = funcDef->retType;
+      validateArgs(funcDef, node->_args, false);
       return;
     }
 
     node->func = funcDef;
     node->type = funcDef->retType;
   } else if (node->_ref->getNodeType() == NodeType::MEMBER_ACCESS) {
-    node->_ref->visit(this);
+    visit(node->_ref);
     if (node->_ref->type->raw == RawDataType::ERROR) {
       node->type = node->_ref->type;
       return;
@@ -584,14 +682,14 @@ void SemanticValidator::visitExprCall(ExprCallNode *node) {
     auto _struct = memberNode->_struct;
 
     if (!node->_ref->func) {
-      name_error("Function " + memberNode->_memberName +
-                     " does not exists on struct " + _struct->type->ident,
+      name_error("Function " + memberNode->_memberName.str() +
+                     " does not exists on struct " + _struct->type->ident.str(),
                  node);
       return;
     }
 
-    auto refToStruct = new ExprUnaryNode(
-        node->_filename, node->_line, node->_startCol, node, "&", 0, _struct);
+    auto refToStruct =
+        new ExprUnaryNode(node->_loc, node, ExprOperator::B_AND, _struct);
 
     node->_args.insert(node->_args.begin(), refToStruct);
     node->func = node->_ref->func;
@@ -600,6 +698,11 @@ void SemanticValidator::visitExprCall(ExprCallNode *node) {
     compile_error("Calling non-function type", node);
   }
 
+  if (function && function->_constant && node->func &&
+      !node->func->_constant)
+    compile_error("Const functions can only call other const functions",
+                  node);
+
   validateArgs(node->func, node->_args);
 }
 
@@ -615,24 +718,128 @@ void SemanticValidator::visitSizeOfCall(ExprCallNode *node) {
   auto varRef = (ExprVarRefNode *)node->_args[0];
   auto var = resolveVar(varRef->_ident);
   auto type = var ? var->type
-                  : DataType::build(TypeDefNode::build(varRef->_ident,
-                                                       varRef->_ident, 0, 0));
+                  : DataType::build(
+                        TypeDefNode::build(varRef->_ident, varRef->_loc));
   node->_ref->type = type;
   node->_ref->var = var;
   node->type = DataType::build(RawDataType::LONG);
 }
 
+FunctionNode *SemanticValidator::instantiate(FunctionNode *generic,
+                                             ExprCallNode *node) {
+  auto &args = node->_args;
+  if (args.size() != generic->_params.size()) {
+    compile_error("Invalid argument count for function " +
+                      generic->_name.str(),
+                  node);
+    return nullptr;
+  }
+
+  // Literals only bind what typed arguments left open, max(x, 1) follows x
+  SymbolMap<DataType *> bindings;
+  for (auto param : generic->_genericArgNames)
+    bindings[param] = nullptr;
+  for (auto arg : args)
+    visit(arg);
+  for (int literals = 0; literals < 2; literals++)
+    for (ulint i = 0; i < args.size(); i++)
+      if (isLiteral(args[i]) == (bool)literals &&
+          !deduce(generic->_params[i]->_typeDef, args[i]->type, literals,
+                  bindings)) {
+        type_error("Conflicting types for argument " + std::to_string(i) +
+                       " in call to " + generic->_name.str(),
+                   node);
+        return nullptr;
+      }
+
+  std::string mangled = generic->_name.str() + "<";
+  for (ulint i = 0; i < generic->_genericArgNames.size(); i++) {
+    auto bound = bindings.lookup(generic->_genericArgNames[i]);
+    if (!bound) {
+      compile_error("Can not deduce type " +
+                        generic->_genericArgNames[i].str() + " in call to " +
+                        generic->_name.str(),
+                    node);
+      return nullptr;
+    }
+    mangled += (i ? "," : "") + typeName(bound);
+  }
+  Symbol implName = mangled + ">";
+
+  if (auto instance = functionInstances.lookup(implName))
+    return instance;
+
+  cloner.clearPrefix();
+  cloner.clearUpdates();
+  for (auto param : generic->_genericArgNames)
+    cloner.setUpdateType(param,
+                         typeDefOf(bindings.lookup(param), generic->_loc));
+  cloner.visitFunction(generic);
+
+  auto instance = (FunctionNode *)cloner.getCloned();
+  instance->_name = implName;
+  instance->_parent = program;
+  instance->_genericOf = generic;
+  functionInstances[implName] = instance;
+
+  // Validated in between the statements of the caller, the return type is
+  // known before the body so recursive calls can use it
+  auto caller = function;
+  auto callerReturned = outWithReturn;
+  visit(instance->_retTypeDef);
+  instance->retType = instance->_retTypeDef->dataType;
+  visit(instance);
+  function = caller;
+  outWithReturn = callerReturned;
+
+  // After the instances its body called, which are created visiting it
+  instances[user].push_back(instance);
+  return instance;
+}
+
+bool SemanticValidator::deduce(TypeDefNode *param, DataType *arg,
+                               bool literal,
+                               SymbolMap<DataType *> &bindings) {
+  if (!arg || arg->raw == RawDataType::ERROR)
+    return true;
+
+  // Shapes that do not match are reported checking the arguments
+  if (param->_pointsTo)
+    return !DataType::isAddress(arg->raw) ||
+           deduce(param->_pointsTo, arg->inner, literal, bindings);
+  if (param->_arrayOf)
+    return arg->raw != RawDataType::ARRAY ||
+           deduce(param->_arrayOf, arg->inner, literal, bindings);
+
+  if (!bindings.contains(param->_rawIdent))
+    return true;
+
+  auto bound = bindings.lookup(param->_rawIdent);
+  if (bound)
+    return literal || bound == arg;
+
+  if (literal && DataType::isNumeric(arg->raw))
+    arg = DataType::build(DataType::isFloat(arg->raw) ? RawDataType::DOUBLE
+                          : arg->raw == RawDataType::LONG ? RawDataType::LONG
+                                                          : RawDataType::INT);
+  bindings[param->_rawIdent] = arg;
+  return true;
+}
+
 void SemanticValidator::validateArgs(FunctionNode *node,
-                                     std::vector<ExprNode *> &args) {
+                                     std::vector<ExprNode *> &args,
+                                     bool visitArgs) {
   if (args.size() != node->_params.size()) {
-    compile_error("Invalid argument count for function " + node->_name, node);
+    compile_error("Invalid argument count for function " + node->_name.str(),
+                  node);
     return;
   }
 
   for (ulint i = 0; i < args.size(); i++) {
-    args[i]->visit(this);
-    auto castedType =
-        DataType::getResultType(node->_params[i]->type, "=", args[i]->type);
+    if (visitArgs)
+      visit(args[i]);
+    auto castedType = DataType::getResultType(
+        node->_params[i]->type, ExprOperator::ASSIGN, args[i]->type);
     bool validType = castedType->equals(node->_params[i]->type);
     if (!validType) {
       type_error("Invalid type for argument " + std::to_string(i) +
@@ -652,64 +859,46 @@ void SemanticValidator::unexpected_error(std::string msg, AstNode *node) {
       "source code at our repository: https://github.com/Gustavo-maia-gst/gu"
       "\n"
       "Error: " +
-      msg + " at: " + std::to_string(node->_line) + ":" +
-      std::to_string(node->_startCol));
+      msg + " at: " + std::to_string(node->_loc.getLine()) + ":" +
+      std::to_string(node->_loc.getCol()));
 };
 
 void SemanticValidator::compile_error(std::string msg, AstNode *node) {
-  errors.push_back(node->_filename + ":" + std::to_string(node->_line) + ":" +
-                   std::to_string(node->_startCol) + " compile error: " + msg);
+  errors.push_back(node->_loc.str() + " compile error: " + msg);
 }
 
 void SemanticValidator::type_error(std::string msg, AstNode *node) {
-  errors.push_back(node->_filename + ":" + std::to_string(node->_line) + ":" +
-                   std::to_string(node->_startCol) + " type error: " + msg);
+  errors.push_back(node->_loc.str() + " type error: " + msg);
 }
 
 void SemanticValidator::name_error(std::string msg, AstNode *node) {
-  errors.push_back(node->_filename + ":" + std::to_string(node->_line) + ":" +
-                   std::to_string(node->_startCol) + " name error: " + msg);
+  errors.push_back(node->_loc.str() + " name error: " + msg);
 }
 
-VarDefNode *SemanticValidator::resolveVar(std::string &varName) {
+VarDefNode *SemanticValidator::resolveVar(Symbol varName) {
   if (!program)
     return nullptr;
 
-  VarDefNode *globalVar, *localVar;
+  VarDefNode *localVar =
+      function ? function->localVars.lookup(varName) : nullptr;
 
-  globalVar = program->globalVars.find(varName) != program->globalVars.end()
-                  ? program->globalVars[varName]
-                  : nullptr;
-
-  if (function)
-    localVar = function->localVars.find(varName) != function->localVars.end()
-                   ? function->localVars[varName]
-                   : nullptr;
-
-  return localVar ? localVar : globalVar;
+  return localVar ? localVar : program->globalVars.lookup(varName);
 }
 
-StructDefNode *SemanticValidator::resolveStruct(std::string &structName) {
+StructDefNode *SemanticValidator::resolveStruct(Symbol structName) {
   if (!program)
     return nullptr;
 
-  bool structExists =
-      program->structDefs.find(structName) != program->structDefs.end();
-  if (!structExists)
-    return nullptr;
-
-  auto structDef = program->structDefs[structName];
-  if (!structDef->_genericArgNames.empty())
+  auto structDef = program->structDefs.lookup(structName);
+  if (!structDef || !structDef->_genericArgNames.empty())
     return nullptr;
 
   return structDef;
 }
 
-FunctionNode *SemanticValidator::resolveFunction(std::string &funcName) {
+FunctionNode *SemanticValidator::resolveFunction(Symbol funcName) {
   if (!program)
     return nullptr;
 
-  return program->funcs.find(funcName) != program->funcs.end()
-             ? program->funcs[funcName]
-             : nullptr;
-}
\ No newline at end of file
+  return program->funcs.lookup(funcName);
+}
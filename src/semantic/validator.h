@@ -2,38 +2,41 @@
 #define _validator
 
 #include "../ast/ast.h"
+#include "../ast/visitor.h"
 #include "../parser/parser.h"
+#include "../parser/processors/astCloner.h"
 #include <iostream>
 #include <map>
 #include <ostream>
 #include <stack>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
-class SemanticValidator : public BaseVisitor {
+class SemanticValidator : public StaticVisitor<SemanticValidator> {
 public:
   SemanticValidator(bool validateMain);
 
-  void visitProgram(ProgramNode *node) override;
-  void visitFunction(FunctionNode *node) override;
-  void visitStructDef(StructDefNode *node) override;
-  void visitBody(BodyNode *node) override;
-  void visitVarDef(VarDefNode *node) override;
-  void visitTypeDefNode(TypeDefNode *node) override;
-
-  void visitIf(IfNode *node) override;
-  void visitWhile(WhileNode *node) override;
-  void visitFor(ForNode *node) override;
-  void visitBreakNode(BreakNode *node) override;
-  void visitReturnNode(ReturnNode *node) override;
-
-  void visitExprVarRef(ExprVarRefNode *node) override;
-  void visitExprConstant(ExprConstantNode *node) override;
-  void visitExprUnaryOp(ExprUnaryNode *node) override;
-  void visitExprBinaryOp(ExprBinaryNode *node) override;
-  void visitMemberAccess(ExprMemberAccess *node) override;
-  void visitIndexAccess(ExprIndex *node) override;
-  void visitExprCall(ExprCallNode *node) override;
+  void visitProgram(ProgramNode *node);
+  void visitFunction(FunctionNode *node);
+  void visitStructDef(StructDefNode *node);
+  void visitBody(BodyNode *node);
+  void visitVarDef(VarDefNode *node);
+  void visitTypeDefNode(TypeDefNode *node);
+
+  void visitIf(IfNode *node);
+  void visitWhile(WhileNode *node);
+  void visitFor(ForNode *node);
+  void visitBreakNode(BreakNode *node);
+  void visitReturnNode(ReturnNode *node);
+
+  void visitExprVarRef(ExprVarRefNode *node);
+  void visitExprConstant(ExprConstantNode *node);
+  void visitExprUnaryOp(ExprUnaryNode *node);
+  void visitExprBinaryOp(ExprBinaryNode *node);
+  void visitMemberAccess(ExprMemberAccess *node);
+  void visitIndexAccess(ExprIndex *node);
+  void visitExprCall(ExprCallNode *node);
   void visitSizeOfCall(ExprCallNode *node);
 
   const std::vector<std::string> getErrors() { return errors; };
@@ -42,17 +45,28 @@ private:
   std::vector<std::string> errors;
   bool validateMain = true;
 
-  void validateArgs(FunctionNode *node,
-                    std::vector<ExprNode *> &args);
+  // Instances of generic functions, keyed by the name with the deduced types,
+  // max<int>, and spliced right before the declaration that first called them
+  AstCloner cloner;
+  SymbolMap<FunctionNode *> functionInstances;
+  std::unordered_map<AstNode *, std::vector<FunctionNode *>> instances;
+  AstNode *user = nullptr;
+
+  FunctionNode *instantiate(FunctionNode *generic, ExprCallNode *node);
+  bool deduce(TypeDefNode *param, DataType *arg, bool literal,
+              SymbolMap<DataType *> &bindings);
+
+  void validateArgs(FunctionNode *node, std::vector<ExprNode *> &args,
+                    bool visitArgs = true);
 
   void unexpected_error(std::string msg, AstNode *node);
   void compile_error(std::string msg, AstNode *node);
   void type_error(std::string msg, AstNode *node);
   void name_error(std::string msg, AstNode *node);
 
-  VarDefNode *resolveVar(std::string &varName);
-  StructDefNode *resolveStruct(std::string &structName);
-  FunctionNode *resolveFunction(std::string &funcName);
+  VarDefNode *resolveVar(Symbol varName);
+  StructDefNode *resolveStruct(Symbol structName);
+  FunctionNode *resolveFunction(Symbol funcName);
 
   ProgramNode *program;
   FunctionNode *function;
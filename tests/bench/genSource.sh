@@ -0,0 +1,37 @@
+#!/bin/bash
+# Writes a large source to parse, blocks of a struct and a function using it
+# usage: tests/bench/genSource.sh [blocks] > big.gu
+blocks=${1:-3000}
+
+for ((i = 0; i < blocks; i++)); do
+  cat <<GU
+struct P$i {
+  x: int;
+  y: int;
+  func init(self: *P$i, a: int) -> void {
+    *self.x = a;
+    *self.y = a * 2 + $i;
+  };
+}
+func f$i(a: int, b: int) -> int {
+  var p: P$i(a);
+  var arr: int[4];
+  var i: int = 0;
+  while i < 3 {
+    i = i + 1;
+    arr[1] = arr[0] * 2 + (a - b) * $((i % 7 + 1));
+    if i == 2 {
+      b = b + p.x;
+    } else {
+      b = b - 1;
+    }
+  }
+  return a + b * arr[1] + i;
+}
+GU
+done
+cat <<GU
+func main() -> int {
+  return f1(1, 2) & 0;
+}
+GU
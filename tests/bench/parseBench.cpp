@@ -0,0 +1,42 @@
+#include "../../src/lexer/lexer.h"
+#include "../../src/parser/parser.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+
+// Parse throughput, best of the repetitions, each in a fresh arena
+// usage: parseBench file [repetitions]
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "usage: parseBench file [repetitions]\n");
+    return 1;
+  }
+
+  struct stat fileStat;
+  if (stat(argv[1], &fileStat) < 0) {
+    std::fprintf(stderr, "Was not possible to read %s\n", argv[1]);
+    return 1;
+  }
+  int repetitions = argc > 2 ? std::atoi(argv[2]) : 15;
+
+  double best = 0;
+  for (int i = 0; i < repetitions; i++) {
+    AstArena arena;
+    AstArena::setCurrent(&arena);
+
+    auto start = std::chrono::steady_clock::now();
+    AstParser parser(Lexer::fromFile(argv[1]));
+    parser.parseProgram();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (!i || elapsed.count() < best)
+      best = elapsed.count();
+
+    AstArena::setCurrent(nullptr);
+  }
+
+  std::printf("parsed %lld bytes in %.4f s, %.1f MB/s\n",
+              (long long)fileStat.st_size, best, fileStat.st_size / best / 1e6);
+  return 0;
+}
@@ -0,0 +1,31 @@
+#!/bin/bash
+# Compiles the samples in parallel jobs, their IR has to be the one a
+# sequential build of the same files gives
+# usage: tests/parallel.sh [compiler] [rounds]
+set -e
+
+gu=$(realpath "${1:-build/debug/bin/gu}")
+rounds=${2:-10}
+samples=$(cd "$(dirname "$0")/parallel" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# Copies of every sample keep all the workers busy at once
+for copy in 1 2 3 4; do
+  for file in "$samples"/*.gu; do
+    cp "$file" "$work/$(basename "$file" .gu)$copy.gu"
+  done
+done
+
+cd "$work"
+for flags in "" "-G"; do
+  "$gu" -j 1 -S basicIR $flags *.gu -o sequential
+  for round in $(seq "$rounds"); do
+    "$gu" -j 8 -S basicIR $flags *.gu -o parallel
+    if ! diff -r sequential parallel > /dev/null; then
+      echo "round $round with flags '$flags': parallel IR differs"
+      exit 1
+    fi
+  done
+done
+echo "parallel IR matches the sequential build"